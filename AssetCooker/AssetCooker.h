@@ -0,0 +1,41 @@
+#ifndef ASSET_COOKER_H
+#define ASSET_COOKER_H
+
+#include "Common.h"
+
+// Bump whenever a cooker changes its output so every asset is rebuilt
+#define ASSET_COOKER_VERSION "4"
+
+enum class CookerType : u8 {
+    Shader,
+    Model,
+    Texture
+};
+
+struct CookDependency {
+    string path;
+    u64 hash = 0;
+};
+
+struct CookJob {
+    CookerType type;
+    string source;
+    string output;
+    u64 hash = 0;
+    // Other files the output was built from, like the .mtl of an .obj or #included shader
+    // headers. Cook functions add the paths, their hashes go into the manifest.
+    array<CookDependency> dependencies;
+    bool succeeded = false;
+};
+
+typedef bool (*CookFunc)(CookJob *job, const char *temp_output);
+
+bool CookShader(CookJob *job, const char *temp_output);
+bool CookModel(CookJob *job, const char *temp_output);
+bool CookTexture(CookJob *job, const char *temp_output);
+
+bool HashFile(const char *path, u64 *hash);
+
+void CookerLog(const char *format, ...);
+
+#endif
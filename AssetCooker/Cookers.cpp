@@ -0,0 +1,183 @@
+#include "AssetCooker.h"
+#include "TextureCompressor.h"
+
+#include <filesystem>
+
+#include "Core/KTX2.h"
+#include "Graphics/ModelData.h"
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb_image.h>
+
+static string GetCompilerPath() {
+    const char *sdk = getenv("VULKAN_SDK");
+    if (!sdk) {
+        return "glslc";
+    }
+
+#ifdef _WIN32
+    return string(sdk) + "\\Bin\\glslc.exe";
+#else
+    return string(sdk) + "/bin/glslc";
+#endif
+}
+
+// Reads the make style rule glslc writes with -MD, "target: source header...".
+// Spaces in paths are escaped with a backslash, lines are continued with one.
+static bool ReadDependencyRule(const char *path, CookJob *job) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+
+    string rule;
+    char buffer[4096];
+    u64 read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        rule.append(buffer, read);
+    }
+    fclose(file);
+
+    u64 start = rule.find(": ");
+    if (start == string::npos) return false;
+
+    string dependency;
+    for (u64 i = start + 2; i <= rule.size(); ++i) {
+        char c = i < rule.size() ? rule[i] : ' ';
+        char next = i + 1 < rule.size() ? rule[i + 1] : 0;
+
+        // Other backslashes are Windows path separators
+        if (c == '\\' && next == ' ') {
+            dependency += ' ';
+            i++;
+        } else if ((c == '\\' && (next == '\r' || next == '\n')) || c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            if (!dependency.empty()) {
+                job->dependencies.push_back({ dependency });
+                dependency.clear();
+            }
+        } else {
+            dependency += c;
+        }
+    }
+
+    return true;
+}
+
+bool CookShader(CookJob *job, const char *temp_output) {
+    static string compiler = GetCompilerPath();
+
+    // -MD lists the #included files, so editing a header recooks every shader using it
+    string dependency_path = string(temp_output) + ".d";
+    string command = "\"" + compiler + "\" \"" + job->source + "\" -o \"" + temp_output + "\" -MD -MF \"" + dependency_path + "\"";
+
+    if (system(command.c_str()) != 0) {
+        CookerLog("Failed to compile shader '%s'", job->source.c_str());
+        std::filesystem::remove(dependency_path);
+        return false;
+    }
+
+    bool read = ReadDependencyRule(dependency_path.c_str(), job);
+    std::filesystem::remove(dependency_path);
+
+    if (!read) {
+        CookerLog("Failed to read the dependencies of shader '%s'", job->source.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+bool CookModel(CookJob *job, const char *temp_output) {
+    CookedModel model;
+
+    array<string> dependencies;
+    if (!ImportModel(job->source.c_str(), &model, &dependencies)) {
+        return false;
+    }
+
+    for (string &dependency : dependencies) {
+        job->dependencies.push_back({ dependency });
+    }
+
+    return SaveCookedModel(temp_output, &model);
+}
+
+static bool IsNormalMap(const string &path) {
+    string stem = std::filesystem::path(path).stem().string();
+
+    static const char *suffixes[] = { "_n", "_normal", "_nrm" };
+    for (const char *suffix : suffixes) {
+        u64 length = strlen(suffix);
+        if (stem.size() >= length && stem.compare(stem.size() - length, length, suffix) == 0) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+static bool HasAlpha(const u8 *rgba, u64 pixel_count) {
+    for (u64 i = 0; i < pixel_count; ++i) {
+        if (rgba[i * 4 + 3] != 255) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Normal maps go to BC5, color with alpha to BC7 and opaque color to BC1.
+// The full mip chain is built here so the runtime only has to copy blocks.
+bool CookTexture(CookJob *job, const char *temp_output) {
+    int width, height, channels;
+    u8 *pixels = stbi_load(job->source.c_str(), &width, &height, &channels, STBI_rgb_alpha);
+
+    if (!pixels) {
+        CookerLog("Failed to load image '%s'", job->source.c_str());
+        return false;
+    }
+
+    bool normal_map = IsNormalMap(job->source);
+    bool srgb = !normal_map;
+
+    KTX2Texture texture;
+    texture.width = u32(width);
+    texture.height = u32(height);
+
+    void (*compress)(const u8 *, u32, u32, array<u8> *);
+    if (normal_map) {
+        texture.format = VK_FORMAT_BC5_UNORM_BLOCK;
+        compress = CompressBC5;
+    } else if (HasAlpha(pixels, u64(width) * u64(height))) {
+        texture.format = VK_FORMAT_BC7_SRGB_BLOCK;
+        compress = CompressBC7;
+    } else {
+        texture.format = VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+        compress = CompressBC1;
+    }
+
+    array<u8> level(pixels, pixels + u64(width) * u64(height) * 4);
+    stbi_image_free(pixels);
+
+    u32 level_width = texture.width;
+    u32 level_height = texture.height;
+
+    while (true) {
+        array<u8> blocks;
+        compress(level.data(), level_width, level_height, &blocks);
+        texture.AddLevel(blocks.data(), blocks.size());
+
+        if (level_width == 1 && level_height == 1) {
+            break;
+        }
+
+        u32 next_width = level_width > 1 ? level_width / 2 : 1;
+        u32 next_height = level_height > 1 ? level_height / 2 : 1;
+
+        array<u8> next(u64(next_width) * next_height * 4);
+        DownsampleImage(level.data(), level_width, level_height, next.data(), srgb);
+
+        level.swap(next);
+        level_width = next_width;
+        level_height = next_height;
+    }
+
+    return texture.Save(temp_output);
+}
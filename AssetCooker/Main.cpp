@@ -0,0 +1,331 @@
+#include "AssetCooker.h"
+
+#include <atomic>
+#include <filesystem>
+#include <mutex>
+#include <thread>
+
+#include "Graphics/ModelData.h"
+
+namespace fs = std::filesystem;
+
+#define MANIFEST_NAME ".cook_manifest"
+
+static std::mutex log_mutex;
+
+void CookerLog(const char *format, ...) {
+    std::lock_guard<std::mutex> lock(log_mutex);
+
+    va_list args;
+    va_start(args, format);
+    vfprintf(stdout, format, args);
+    putc('\n', stdout);
+    va_end(args);
+}
+
+bool HashFile(const char *path, u64 *hash) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+
+    u8 buffer[64 * 1024];
+    u64 read;
+    while ((read = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        *hash = HashBytes(buffer, read, *hash);
+    }
+
+    fclose(file);
+    return true;
+}
+
+static bool HashDependency(const char *path, u64 *hash) {
+    *hash = HashBytes(0, 0);
+    return HashFile(path, hash);
+}
+
+static CookFunc GetCookFunc(CookerType type) {
+    switch (type) {
+        case CookerType::Shader: return CookShader;
+        case CookerType::Model: return CookModel;
+        case CookerType::Texture: return CookTexture;
+    }
+    return 0;
+}
+
+static bool ClassifyAsset(const fs::path &path, CookJob *job) {
+    static const pair<const char *, CookerType> extensions[] = {
+        { ".vert", CookerType::Shader },
+        { ".frag", CookerType::Shader },
+        { ".comp", CookerType::Shader },
+        { ".obj", CookerType::Model },
+        { ".fbx", CookerType::Model },
+        { ".gltf", CookerType::Model },
+        { ".glb", CookerType::Model },
+        { ".png", CookerType::Texture },
+        { ".jpg", CookerType::Texture },
+        { ".jpeg", CookerType::Texture },
+        { ".tga", CookerType::Texture }
+    };
+
+    static const char *output_extensions[] = { ".spv", ".model", ".ktx2" };
+
+    string extension = path.extension().string();
+    for (auto &&[ext, type] : extensions) {
+        if (extension == ext) {
+            job->type = type;
+            job->source = path.generic_string();
+            job->output = job->source + output_extensions[u32(type)];
+            return true;
+        }
+    }
+
+    return false;
+}
+
+struct ManifestEntry {
+    u64 hash;
+    array<CookDependency> dependencies;
+};
+
+// Every output is a line with its hash, followed by its dependencies indented by a tab
+static map<string, ManifestEntry> ReadManifest(const string &path) {
+    map<string, ManifestEntry> manifest;
+
+    FILE *file = fopen(path.c_str(), "r");
+    if (!file) return manifest;
+
+    ManifestEntry *entry = 0;
+
+    char line[1024];
+    while (fgets(line, sizeof(line), file)) {
+        unsigned long long hash;
+        char name[1000];
+
+        if (line[0] == '\t') {
+            if (entry && sscanf(line + 1, "%llx %999[^\n]", &hash, name) == 2) {
+                entry->dependencies.push_back({ name, hash });
+            }
+        } else if (sscanf(line, "%llx %999[^\n]", &hash, name) == 2) {
+            entry = &manifest[name];
+            entry->hash = hash;
+            entry->dependencies.clear();
+        } else {
+            entry = 0;
+        }
+    }
+
+    fclose(file);
+    return manifest;
+}
+
+static bool DependenciesUnchanged(array<CookDependency> &dependencies) {
+    for (CookDependency &dependency : dependencies) {
+        u64 hash;
+        if (!HashDependency(dependency.path.c_str(), &hash) || hash != dependency.hash) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Lists the dependencies next to the output, IsCookedFileUpToDate checks their modification times
+static bool WriteDependencyFile(CookJob *job) {
+    string path = job->output + ".deps";
+
+    if (job->dependencies.empty()) {
+        std::error_code error;
+        fs::remove(path, error);
+        return true;
+    }
+
+    string temp_path = path + ".tmp";
+
+    FILE *file = fopen(temp_path.c_str(), "w");
+    if (!file) return false;
+
+    for (CookDependency &dependency : job->dependencies) {
+        fprintf(file, "%s\n", dependency.path.c_str());
+    }
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+
+    std::error_code error;
+    fs::rename(temp_path, path, error);
+
+    return ok && !error;
+}
+
+static void WriteManifest(const string &path, array<CookJob> &jobs) {
+    string temp_path = path + ".tmp";
+
+    FILE *file = fopen(temp_path.c_str(), "w");
+    if (!file) {
+        CookerLog("Failed to write manifest '%s'", path.c_str());
+        return;
+    }
+
+    for (CookJob &job : jobs) {
+        if (job.succeeded) {
+            fprintf(file, "%016llx %s\n", (unsigned long long) job.hash, job.output.c_str());
+
+            for (CookDependency &dependency : job.dependencies) {
+                fprintf(file, "\t%016llx %s\n", (unsigned long long) dependency.hash, dependency.path.c_str());
+            }
+        }
+    }
+
+    fclose(file);
+
+    std::error_code error;
+    fs::rename(temp_path, path, error);
+}
+
+static void RunJob(CookJob *job) {
+    string temp_output = job->output + ".tmp";
+
+    CookFunc cook = GetCookFunc(job->type);
+    if (!cook(job, temp_output.c_str())) {
+        fs::remove(temp_output);
+        return;
+    }
+
+    // Tools report paths in their own spelling, and the source itself isn't a dependency
+    array<CookDependency> dependencies;
+    dependencies.swap(job->dependencies);
+
+    for (CookDependency &dependency : dependencies) {
+        string path = fs::path(dependency.path).lexically_normal().generic_string();
+
+        bool known = path == job->source;
+        for (CookDependency &other : job->dependencies) {
+            known = known || other.path == path;
+        }
+        if (known) {
+            continue;
+        }
+
+        if (!HashDependency(path.c_str(), &dependency.hash)) {
+            CookerLog("Failed to read '%s', a dependency of '%s'", path.c_str(), job->source.c_str());
+            fs::remove(temp_output);
+            return;
+        }
+
+        dependency.path = path;
+        job->dependencies.push_back(dependency);
+    }
+
+    if (!WriteDependencyFile(job)) {
+        CookerLog("Failed to write the dependencies of '%s'", job->output.c_str());
+        fs::remove(temp_output);
+        return;
+    }
+
+    // Rename so a cancelled or failed cook never leaves a partial output behind
+    std::error_code error;
+    fs::rename(temp_output, job->output, error);
+    if (error) {
+        CookerLog("Failed to write '%s': %s", job->output.c_str(), error.message().c_str());
+        return;
+    }
+
+    job->succeeded = true;
+    CookerLog("Cooked %s", job->source.c_str());
+}
+
+int main(int argc, char **argv) {
+    const char *asset_dir = "Renderer/Assets";
+    u32 thread_count = std::thread::hardware_concurrency();
+    bool force = false;
+
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--force") == 0) {
+            force = true;
+        } else if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) {
+            thread_count = u32(atoi(argv[++i]));
+        } else {
+            asset_dir = argv[i];
+        }
+    }
+
+    if (thread_count == 0) {
+        thread_count = 1;
+    }
+
+    if (!fs::is_directory(asset_dir)) {
+        LogFatal("Asset directory '%s' does not exist", asset_dir);
+    }
+
+    string manifest_path = (fs::path(asset_dir) / MANIFEST_NAME).generic_string();
+    map<string, ManifestEntry> manifest = ReadManifest(manifest_path);
+
+    array<CookJob> jobs;
+    for (const fs::directory_entry &entry : fs::recursive_directory_iterator(asset_dir)) {
+        CookJob job;
+        if (!entry.is_regular_file() || !ClassifyAsset(entry.path(), &job)) {
+            continue;
+        }
+
+        // Outputs are keyed by the content of their inputs and the cooker version
+        job.hash = HashBytes(ASSET_COOKER_VERSION, strlen(ASSET_COOKER_VERSION));
+        job.hash = HashBytes(&job.type, sizeof(job.type), job.hash);
+        // The runtime rejects models of another layout, so they're rebuilt whenever it changes
+        if (job.type == CookerType::Model) {
+            u32 model_version = COOKED_MODEL_VERSION;
+            job.hash = HashBytes(&model_version, sizeof(model_version), job.hash);
+        }
+        if (!HashFile(job.source.c_str(), &job.hash)) {
+            CookerLog("Failed to read '%s'", job.source.c_str());
+            continue;
+        }
+
+        jobs.push_back(job);
+    }
+
+    array<CookJob *> pending;
+    for (CookJob &job : jobs) {
+        // Up to date only when the source and every dependency still hash the same
+        auto it = manifest.find(job.output);
+        if (!force && it != manifest.end() && it->second.hash == job.hash &&
+            DependenciesUnchanged(it->second.dependencies) && fs::exists(job.output)) {
+            job.dependencies = it->second.dependencies;
+            job.succeeded = true;
+            continue;
+        }
+
+        pending.push_back(&job);
+    }
+
+    CookerLog("Cooking %zu of %zu assets on %u threads", pending.size(), jobs.size(), thread_count);
+
+    std::atomic<u64> next_job = 0;
+    auto worker = [&]() {
+        for (u64 i = next_job++; i < pending.size(); i = next_job++) {
+            RunJob(pending[i]);
+        }
+    };
+
+    array<std::thread> threads;
+    for (u32 i = 0; i < thread_count; ++i) {
+        threads.emplace_back(worker);
+    }
+    for (std::thread &thread : threads) {
+        thread.join();
+    }
+
+    WriteManifest(manifest_path, jobs);
+
+    u32 failed = 0;
+    for (CookJob *job : pending) {
+        if (!job->succeeded) {
+            failed++;
+        }
+    }
+
+    if (failed) {
+        LogError("%u assets failed to cook", failed);
+        return 1;
+    }
+
+    return 0;
+}
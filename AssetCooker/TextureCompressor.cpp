@@ -0,0 +1,400 @@
+#include "TextureCompressor.h"
+
+#include <math.h>
+
+struct BitWriter {
+    u8 *data;
+    u32 position = 0;
+
+    void Write(u32 value, u32 bits) {
+        for (u32 i = 0; i < bits; ++i) {
+            if ((value >> i) & 1) {
+                data[position >> 3] |= u8(1 << (position & 7));
+            }
+            position++;
+        }
+    }
+};
+
+static u8 ClampByte(f32 value) {
+    if (value < 0.0f) return 0;
+    if (value > 255.0f) return 255;
+    return u8(value + 0.5f);
+}
+
+static void FetchBlock(const u8 *rgba, u32 width, u32 height, u32 block_x, u32 block_y, u8 block[16][4]) {
+    for (u32 y = 0; y < 4; ++y) {
+        for (u32 x = 0; x < 4; ++x) {
+            u32 px = block_x * 4 + x;
+            u32 py = block_y * 4 + y;
+            if (px >= width) px = width - 1;
+            if (py >= height) py = height - 1;
+
+            memcpy(block[y * 4 + x], &rgba[(py * width + px) * 4], 4);
+        }
+    }
+}
+
+// Direction of largest variance of the first channel_count channels, found by power iteration
+static void PrincipalAxis(const u8 block[16][4], u32 channel_count, f32 axis[4]) {
+    f32 mean[4] = {};
+    for (u32 i = 0; i < 16; ++i) {
+        for (u32 c = 0; c < channel_count; ++c) {
+            mean[c] += block[i][c] / 16.0f;
+        }
+    }
+
+    f32 covariance[4][4] = {};
+    for (u32 i = 0; i < 16; ++i) {
+        for (u32 a = 0; a < channel_count; ++a) {
+            for (u32 b = 0; b < channel_count; ++b) {
+                covariance[a][b] += (block[i][a] - mean[a]) * (block[i][b] - mean[b]);
+            }
+        }
+    }
+
+    for (u32 c = 0; c < 4; ++c) {
+        axis[c] = c < channel_count ? 1.0f : 0.0f;
+    }
+
+    for (u32 iteration = 0; iteration < 8; ++iteration) {
+        f32 next[4] = {};
+        for (u32 a = 0; a < channel_count; ++a) {
+            for (u32 b = 0; b < channel_count; ++b) {
+                next[a] += covariance[a][b] * axis[b];
+            }
+        }
+
+        f32 length = 0.0f;
+        for (u32 c = 0; c < channel_count; ++c) {
+            length += next[c] * next[c];
+        }
+
+        // Flat block, any axis will do
+        if (length < 1e-8f) {
+            return;
+        }
+
+        length = sqrtf(length);
+        for (u32 c = 0; c < channel_count; ++c) {
+            axis[c] = next[c] / length;
+        }
+    }
+}
+
+// Picks the two pixels at the extremes of the principal axis
+static void FindEndpoints(const u8 block[16][4], u32 channel_count, u32 *min_index, u32 *max_index) {
+    f32 axis[4];
+    PrincipalAxis(block, channel_count, axis);
+
+    f32 min_projection = 1e30f;
+    f32 max_projection = -1e30f;
+    *min_index = 0;
+    *max_index = 0;
+
+    for (u32 i = 0; i < 16; ++i) {
+        f32 projection = 0.0f;
+        for (u32 c = 0; c < channel_count; ++c) {
+            projection += block[i][c] * axis[c];
+        }
+
+        if (projection < min_projection) {
+            min_projection = projection;
+            *min_index = i;
+        }
+        if (projection > max_projection) {
+            max_projection = projection;
+            *max_index = i;
+        }
+    }
+}
+
+static u16 Pack565(const u8 color[4]) {
+    u32 r = (color[0] * 31 + 127) / 255;
+    u32 g = (color[1] * 63 + 127) / 255;
+    u32 b = (color[2] * 31 + 127) / 255;
+    return u16((r << 11) | (g << 5) | b);
+}
+
+static void Unpack565(u16 packed, s32 color[3]) {
+    s32 r = (packed >> 11) & 31;
+    s32 g = (packed >> 5) & 63;
+    s32 b = packed & 31;
+    color[0] = (r << 3) | (r >> 2);
+    color[1] = (g << 2) | (g >> 4);
+    color[2] = (b << 3) | (b >> 2);
+}
+
+static void EncodeBC1Block(const u8 block[16][4], u8 *out) {
+    u32 min_index, max_index;
+    FindEndpoints(block, 3, &min_index, &max_index);
+
+    u16 color0 = Pack565(block[max_index]);
+    u16 color1 = Pack565(block[min_index]);
+
+    // color0 > color1 selects the opaque four color mode
+    if (color0 < color1) {
+        u16 temp = color0;
+        color0 = color1;
+        color1 = temp;
+    }
+
+    u32 indices = 0;
+
+    if (color0 != color1) {
+        s32 palette[4][3];
+        Unpack565(color0, palette[0]);
+        Unpack565(color1, palette[1]);
+        for (u32 c = 0; c < 3; ++c) {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for (u32 i = 0; i < 16; ++i) {
+            u32 best = 0;
+            s32 best_error = INT32_MAX;
+
+            for (u32 p = 0; p < 4; ++p) {
+                s32 error = 0;
+                for (u32 c = 0; c < 3; ++c) {
+                    s32 d = s32(block[i][c]) - palette[p][c];
+                    error += d * d;
+                }
+
+                if (error < best_error) {
+                    best_error = error;
+                    best = p;
+                }
+            }
+
+            indices |= best << (i * 2);
+        }
+    }
+
+    memcpy(out + 0, &color0, 2);
+    memcpy(out + 2, &color1, 2);
+    memcpy(out + 4, &indices, 4);
+}
+
+static void EncodeBC4Block(const u8 block[16][4], u32 channel, u8 *out) {
+    u8 max_value = 0;
+    u8 min_value = 255;
+    for (u32 i = 0; i < 16; ++i) {
+        u8 value = block[i][channel];
+        if (value > max_value) max_value = value;
+        if (value < min_value) min_value = value;
+    }
+
+    // red0 > red1 selects the eight value mode
+    memset(out, 0, 8);
+    out[0] = max_value;
+    out[1] = min_value;
+
+    if (max_value == min_value) {
+        return;
+    }
+
+    BitWriter writer = { out + 2 };
+    for (u32 i = 0; i < 16; ++i) {
+        u32 step = (u32(block[i][channel] - min_value) * 14 + (max_value - min_value)) / (2 * (max_value - min_value));
+
+        // Steps run from red1 (0) to red0 (7), the interpolated values are stored in reverse
+        u32 index;
+        if (step == 7) index = 0;
+        else if (step == 0) index = 1;
+        else index = 8 - step;
+
+        writer.Write(index, 3);
+    }
+}
+
+static const u32 BC7_WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Quantizes an endpoint to 7 bits per channel plus a shared p-bit
+static void QuantizeBC7Endpoint(const u8 color[4], u32 quantized[4], u32 *p_bit) {
+    u32 best_error = UINT32_MAX;
+
+    for (u32 p = 0; p < 2; ++p) {
+        u32 candidate[4];
+        u32 error = 0;
+
+        for (u32 c = 0; c < 4; ++c) {
+            s32 q = (s32(color[c]) - s32(p) + 1) / 2;
+            if (q < 0) q = 0;
+            if (q > 127) q = 127;
+
+            candidate[c] = u32(q);
+            s32 d = s32((q << 1) | p) - s32(color[c]);
+            error += u32(d * d);
+        }
+
+        if (error < best_error) {
+            best_error = error;
+            *p_bit = p;
+            memcpy(quantized, candidate, sizeof(candidate));
+        }
+    }
+}
+
+static void EncodeBC7Block(const u8 block[16][4], u8 *out) {
+    u32 min_index, max_index;
+    FindEndpoints(block, 4, &min_index, &max_index);
+
+    u32 endpoints[2][4];
+    u32 p_bits[2];
+    QuantizeBC7Endpoint(block[min_index], endpoints[0], &p_bits[0]);
+    QuantizeBC7Endpoint(block[max_index], endpoints[1], &p_bits[1]);
+
+    s32 palette[16][4];
+    for (u32 c = 0; c < 4; ++c) {
+        s32 e0 = s32((endpoints[0][c] << 1) | p_bits[0]);
+        s32 e1 = s32((endpoints[1][c] << 1) | p_bits[1]);
+
+        for (u32 i = 0; i < 16; ++i) {
+            palette[i][c] = ((64 - s32(BC7_WEIGHTS4[i])) * e0 + s32(BC7_WEIGHTS4[i]) * e1 + 32) >> 6;
+        }
+    }
+
+    u32 indices[16];
+    for (u32 i = 0; i < 16; ++i) {
+        s32 best_error = INT32_MAX;
+
+        for (u32 p = 0; p < 16; ++p) {
+            s32 error = 0;
+            for (u32 c = 0; c < 4; ++c) {
+                s32 d = s32(block[i][c]) - palette[p][c];
+                error += d * d;
+            }
+
+            if (error < best_error) {
+                best_error = error;
+                indices[i] = p;
+            }
+        }
+    }
+
+    // The anchor index only stores 3 bits, so its top bit has to be zero
+    if (indices[0] & 8) {
+        for (u32 c = 0; c < 4; ++c) {
+            u32 temp = endpoints[0][c];
+            endpoints[0][c] = endpoints[1][c];
+            endpoints[1][c] = temp;
+        }
+
+        u32 temp = p_bits[0];
+        p_bits[0] = p_bits[1];
+        p_bits[1] = temp;
+
+        for (u32 i = 0; i < 16; ++i) {
+            indices[i] = 15 - indices[i];
+        }
+    }
+
+    memset(out, 0, 16);
+    BitWriter writer = { out };
+
+    // Mode 6
+    writer.Write(1 << 6, 7);
+
+    for (u32 c = 0; c < 4; ++c) {
+        writer.Write(endpoints[0][c], 7);
+        writer.Write(endpoints[1][c], 7);
+    }
+
+    writer.Write(p_bits[0], 1);
+    writer.Write(p_bits[1], 1);
+
+    writer.Write(indices[0], 3);
+    for (u32 i = 1; i < 16; ++i) {
+        writer.Write(indices[i], 4);
+    }
+}
+
+typedef void (*EncodeBlockFunc)(const u8 block[16][4], u8 *out);
+
+static void CompressBlocks(const u8 *rgba, u32 width, u32 height, u32 block_bytes, EncodeBlockFunc encode, array<u8> *out) {
+    u32 blocks_x = (width + 3) / 4;
+    u32 blocks_y = (height + 3) / 4;
+
+    out->resize(u64(blocks_x) * blocks_y * block_bytes);
+
+    for (u32 by = 0; by < blocks_y; ++by) {
+        for (u32 bx = 0; bx < blocks_x; ++bx) {
+            u8 block[16][4];
+            FetchBlock(rgba, width, height, bx, by, block);
+
+            encode(block, out->data() + (u64(by) * blocks_x + bx) * block_bytes);
+        }
+    }
+}
+
+static void EncodeBC5Block(const u8 block[16][4], u8 *out) {
+    EncodeBC4Block(block, 0, out);
+    EncodeBC4Block(block, 1, out + 8);
+}
+
+void CompressBC1(const u8 *rgba, u32 width, u32 height, array<u8> *out) {
+    CompressBlocks(rgba, width, height, 8, EncodeBC1Block, out);
+}
+
+void CompressBC5(const u8 *rgba, u32 width, u32 height, array<u8> *out) {
+    CompressBlocks(rgba, width, height, 16, EncodeBC5Block, out);
+}
+
+void CompressBC7(const u8 *rgba, u32 width, u32 height, array<u8> *out) {
+    CompressBlocks(rgba, width, height, 16, EncodeBC7Block, out);
+}
+
+static f32 SRGBToLinear(f32 value) {
+    return value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static f32 LinearToSRGB(f32 value) {
+    return value <= 0.0031308f ? value * 12.92f : 1.055f * powf(value, 1.0f / 2.4f) - 0.055f;
+}
+
+void DownsampleImage(const u8 *src, u32 src_width, u32 src_height, u8 *dst, bool srgb) {
+    static f32 srgb_to_linear[256];
+    static bool table_initialized = [] {
+        for (u32 i = 0; i < 256; ++i) {
+            srgb_to_linear[i] = SRGBToLinear(i / 255.0f);
+        }
+        return true;
+    }();
+    (void) table_initialized;
+
+    u32 dst_width = src_width > 1 ? src_width / 2 : 1;
+    u32 dst_height = src_height > 1 ? src_height / 2 : 1;
+
+    for (u32 y = 0; y < dst_height; ++y) {
+        for (u32 x = 0; x < dst_width; ++x) {
+            u32 x0 = x * 2 < src_width ? x * 2 : src_width - 1;
+            u32 y0 = y * 2 < src_height ? y * 2 : src_height - 1;
+            u32 x1 = x0 + 1 < src_width ? x0 + 1 : x0;
+            u32 y1 = y0 + 1 < src_height ? y0 + 1 : y0;
+
+            const u8 *samples[4] = {
+                &src[(y0 * src_width + x0) * 4],
+                &src[(y0 * src_width + x1) * 4],
+                &src[(y1 * src_width + x0) * 4],
+                &src[(y1 * src_width + x1) * 4]
+            };
+
+            u8 *pixel = &dst[(y * dst_width + x) * 4];
+
+            for (u32 c = 0; c < 4; ++c) {
+                // Alpha is always linear
+                if (srgb && c < 3) {
+                    f32 sum = 0.0f;
+                    for (u32 s = 0; s < 4; ++s) {
+                        sum += srgb_to_linear[samples[s][c]];
+                    }
+                    pixel[c] = ClampByte(LinearToSRGB(sum / 4.0f) * 255.0f);
+                } else {
+                    u32 sum = samples[0][c] + samples[1][c] + samples[2][c] + samples[3][c];
+                    pixel[c] = u8((sum + 2) / 4);
+                }
+            }
+        }
+    }
+}
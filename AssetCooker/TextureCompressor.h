@@ -0,0 +1,19 @@
+#ifndef TEXTURE_COMPRESSOR_H
+#define TEXTURE_COMPRESSOR_H
+
+#include "Common.h"
+
+// Block compressors operating on tightly packed RGBA8 images.
+// Images whose size is not a multiple of 4 are padded by clamping to the edge.
+
+// Opaque color, 8 bytes per block
+void CompressBC1(const u8 *rgba, u32 width, u32 height, array<u8> *out);
+// Two channel data such as tangent space normals (R and G), 16 bytes per block
+void CompressBC5(const u8 *rgba, u32 width, u32 height, array<u8> *out);
+// Color with alpha, mode 6 only, 16 bytes per block
+void CompressBC7(const u8 *rgba, u32 width, u32 height, array<u8> *out);
+
+// Box filters to the next mip level, in linear space if srgb is set
+void DownsampleImage(const u8 *src, u32 src_width, u32 src_height, u8 *dst, bool srgb);
+
+#endif
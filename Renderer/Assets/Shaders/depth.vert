@@ -0,0 +1,50 @@
+#version 450
+
+// Depth pre-pass, has to compute gl_Position exactly like lowpoly.vert
+// so the main pass can test against it with EQUAL
+
+invariant gl_Position;
+
+struct VertexPosition {
+    float x, y, z;
+};
+
+struct DirectionalLight {
+	vec4 ambient;
+	vec4 diffuse;
+	vec3 dir;
+};
+
+layout(binding=0) readonly buffer SceneData {
+    mat4 projection_matrix;
+    mat4 view_matrix;
+    DirectionalLight dir_light;
+};
+
+layout(binding=1) readonly buffer VertexPositions {
+    VertexPosition positions[];
+};
+
+struct DrawData {
+    mat4 model_matrix;
+    mat4 previous_model_matrix;
+};
+
+layout(binding=2) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
+
+layout(push_constant) uniform MeshData {
+    uint draw_index;
+    uint material_index;
+};
+
+void main() {
+    VertexPosition p = positions[gl_VertexIndex];
+    vec4 position = vec4(p.x, p.y, p.z, 1.0);
+
+    vec4 world_pos = draws[draw_index].model_matrix * position;
+    vec4 view_pos = view_matrix * world_pos;
+
+	gl_Position = projection_matrix * view_pos;
+}
@@ -1,9 +1,179 @@
 #version 450
 
-layout (location=0) in vec4 frag_color;
+layout (location=0) in vec3 world_pos;
+layout (location=1) in vec3 normal;
+layout (location=2) in float view_depth;
+layout (location=3) flat in uint material_index;
+layout (location=4) in vec4 current_clip;
+layout (location=5) in vec4 previous_clip;
+layout (location=6) in vec2 tex_coord;
 
 layout (location=0) out vec4 out_color;
+// Screen UV offset to where this surface was last frame, read by taa.comp
+layout (location=1) out vec2 out_velocity;
+
+// Set per pipeline, see LOWPOLY_CONSTANT_* and CLUSTER_* in SceneRenderer.h
+layout(constant_id = 0) const bool DIR_LIGHT_ENABLED = true;
+layout(constant_id = 1) const uint DEBUG_MODE = 0;
+layout(constant_id = 2) const uint CLUSTER_X = 16;
+layout(constant_id = 3) const uint CLUSTER_Y = 9;
+layout(constant_id = 4) const uint CLUSTER_Z = 24;
+layout(constant_id = 5) const uint CLUSTER_MAX_LIGHTS = 128;
+
+#define DEBUG_MODE_NORMALS 1
+#define DEBUG_MODE_ALBEDO 2
+#define DEBUG_MODE_LIGHT_COUNT 3
+
+// See SHADOW_CASCADES in ShadowRenderer.h
+#define SHADOW_CASCADES 4
+
+struct Material {
+    vec4 ambient;
+    vec4 diffuse;
+    vec4 specular;
+    float shininess;
+};
+
+struct DirectionalLight {
+	vec4 ambient;
+	vec4 diffuse;
+	vec3 dir;
+};
+
+struct PointLight {
+	vec4 ambient;
+	vec4 diffuse;
+	vec3 pos;
+	float radius;
+};
+
+layout(binding=0) readonly buffer SceneData {
+    mat4 projection_matrix;
+    mat4 view_matrix;
+    DirectionalLight dir_light;
+    mat4 inverse_projection;
+    vec2 screen_size;
+    float z_near;
+    float z_far;
+    uint num_point_lights;
+};
+
+layout(binding=3) readonly buffer MaterialData {
+    Material materials[];
+};
+
+layout(binding=4) readonly buffer LightData {
+    PointLight lights[];
+};
+
+layout(binding=5) readonly buffer ClusterLights {
+    uint cluster_lights[];
+};
+
+layout(binding=6) uniform sampler2DArrayShadow shadow_map;
+
+layout(binding=7) readonly buffer ShadowData {
+    mat4 cascade_matrices[SHADOW_CASCADES];
+    vec4 cascade_splits;
+    vec4 cascade_texel_sizes;
+};
+
+// Streamed, or a white texel for materials without one
+layout(binding=9) uniform sampler2D diffuse_texture;
+
+vec3 CalculateDirLight(DirectionalLight light, Material mat, vec3 normal, float shadow) {
+	vec3 ray = normalize(light.dir);
+
+    // say mat.diffuse here because my assets atm dont have ambient set
+    vec4 ambient = light.ambient * mat.diffuse;
+    float diff = max(dot(normal, ray), 0.0);
+    vec4 diffuse = light.diffuse * (diff * mat.diffuse * shadow);
+
+	return (ambient + diffuse).xyz;
+}
+
+float CalculateShadow(vec3 frag_pos, vec3 normal) {
+    if (view_depth > cascade_splits[SHADOW_CASCADES - 1]) {
+        return 1.0;
+    }
+
+    uint cascade = 0;
+    for (uint i = 0; i < SHADOW_CASCADES - 1; i++) {
+        if (view_depth > cascade_splits[i]) {
+            cascade = i + 1;
+        }
+    }
+
+    // Offsetting along the normal fights acne on surfaces at grazing angles
+    vec3 offset_pos = frag_pos + normal * cascade_texel_sizes[cascade] * 1.5;
+    vec4 light_pos = cascade_matrices[cascade] * vec4(offset_pos, 1.0);
+    vec2 uv = light_pos.xy * 0.5 + 0.5;
+
+    vec2 texel = 1.0 / vec2(textureSize(shadow_map, 0).xy);
+    float shadow = 0.0;
+
+    for (int y = -1; y <= 1; y++) {
+        for (int x = -1; x <= 1; x++) {
+            shadow += texture(shadow_map, vec4(uv + vec2(x, y) * texel, float(cascade), light_pos.z));
+        }
+    }
+
+    return shadow / 9.0;
+}
+
+vec3 CalculatePointLight(PointLight light, Material mat, vec3 normal, vec3 frag_pos) {
+	vec3 to_light = light.pos - frag_pos;
+	float distance = length(to_light);
+	vec3 ray = to_light / distance;
+
+	// Reaches zero at the radius, so culling by radius doesn't cut off light
+	float window = clamp(1.0 - pow(distance / light.radius, 4.0), 0.0, 1.0);
+	float attenuation = window * window / (distance * distance + 1.0);
+
+    // say mat.diffuse here because my assets atm dont have ambient set
+	vec4 ambient = light.ambient * mat.diffuse;
+	float diff = max(dot(normal, ray), 0.0);
+	vec4 diffuse = light.diffuse * (diff * mat.diffuse);
+
+	return (ambient + diffuse).xyz * attenuation;
+}
+
+uint ClusterIndex() {
+    uvec2 tile = uvec2(gl_FragCoord.xy / screen_size * vec2(CLUSTER_X, CLUSTER_Y));
+    uint slice = uint(max(log(view_depth / z_near) / log(z_far / z_near) * float(CLUSTER_Z), 0.0));
+
+    tile = min(tile, uvec2(CLUSTER_X - 1, CLUSTER_Y - 1));
+    slice = min(slice, CLUSTER_Z - 1);
+
+    return tile.x + tile.y * CLUSTER_X + slice * CLUSTER_X * CLUSTER_Y;
+}
 
 void main() {
-	out_color = frag_color;
+    Material m = materials[material_index];
+    m.diffuse *= texture(diffuse_texture, tex_coord);
+    vec3 norm = normalize(normal);
+
+    vec3 result = vec3(0.0);
+
+    if (DIR_LIGHT_ENABLED) {
+        result += CalculateDirLight(dir_light, m, norm, CalculateShadow(world_pos, norm));
+    }
+
+    uint base = ClusterIndex() * (CLUSTER_MAX_LIGHTS + 1);
+    uint count = cluster_lights[base];
+
+	for (uint i = 0; i < count; i++) {
+		result += CalculatePointLight(lights[cluster_lights[base + 1 + i]], m, norm, world_pos);
+	}
+
+    if (DEBUG_MODE == DEBUG_MODE_NORMALS) {
+        result = norm * 0.5 + 0.5;
+    } else if (DEBUG_MODE == DEBUG_MODE_ALBEDO) {
+        result = m.diffuse.rgb;
+    } else if (DEBUG_MODE == DEBUG_MODE_LIGHT_COUNT) {
+        result = mix(vec3(0.0, 0.0, 0.5), vec3(1.0, 0.0, 0.0), min(float(count) / 32.0, 1.0));
+    }
+
+	out_color = vec4(result, 1.0);
+    out_velocity = (current_clip.xy / current_clip.w - previous_clip.xy / previous_clip.w) * 0.5;
 }
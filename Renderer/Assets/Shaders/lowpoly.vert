@@ -2,93 +2,87 @@
 
 #extension GL_EXT_shader_explicit_arithmetic_types: require
 
-layout (location=0) out vec4 frag_color;
+// Matches depth.vert bit for bit, the depth pre-pass relies on it
+invariant gl_Position;
+
+layout (location=0) out vec3 out_world_pos;
+layout (location=1) out vec3 out_normal;
+layout (location=2) out float out_view_depth;
+layout (location=3) flat out uint out_material_index;
+// Unjittered clip positions of this and the previous frame, for the motion vectors
+layout (location=4) out vec4 out_current_clip;
+layout (location=5) out vec4 out_previous_clip;
+layout (location=6) out vec2 out_tex_coord;
+
+struct VertexPosition {
+    float x, y, z;
+};
 
-struct Vertex {
-    float px, py, pz;
+struct VertexAttributes {
     uint8_t nx, ny, nz, nw;
     float tu, tv;
 };
 
-struct Material {
-    vec4 ambient;
-    vec4 diffuse;
-    vec4 specular;
-    float shininess; 
-};
-
 struct DirectionalLight {
 	vec4 ambient;
 	vec4 diffuse;
 	vec3 dir;
 };
 
-struct PointLight {
-	vec4 ambient;
-	vec4 diffuse;
-	vec3 pos;
-};
-
 layout(binding=0) readonly buffer SceneData {
     mat4 projection_matrix;
     mat4 view_matrix;
     DirectionalLight dir_light;
-    uint8_t num_point_lights;
-    PointLight point_lights[10];
+    mat4 inverse_projection;
+    vec2 screen_size;
+    float z_near;
+    float z_far;
+    uint num_point_lights;
+    mat4 view_projection;
+    mat4 previous_view_projection;
 };
 
-layout(binding=1) readonly buffer VertexData {
-    Vertex vertices[];
+layout(binding=1) readonly buffer VertexPositions {
+    VertexPosition positions[];
 };
 
-layout(binding=2) readonly buffer MaterialData {
-    Material materials[];
+layout(binding=2) readonly buffer VertexAttributeData {
+    VertexAttributes attributes[];
 };
 
-layout(push_constant) uniform MeshData {
+struct DrawData {
     mat4 model_matrix;
-    uint material_index;
+    mat4 previous_model_matrix;
 };
 
-vec3 CalculateDirLight(DirectionalLight light, Material mat, vec3 normal) {
-	vec3 ray = normalize(light.dir);
-	
-    // say mat.diffuse here because my assets atm dont have ambient set
-    vec4 ambient = light.ambient * mat.diffuse;
-    float diff = max(dot(normal, ray), 0.0);
-    vec4 diffuse = light.diffuse * (diff * mat.diffuse);
-
-	return (ambient + diffuse).xyz;
-}
-
-vec3 CalculatePointLight(PointLight light, Material mat, vec3 normal, vec3 frag_pos) {
-	vec3 ray = normalize(light.pos - frag_pos);
-	
-    // say mat.diffuse here because my assets atm dont have ambient set
-	vec4 ambient = light.ambient * mat.diffuse;
-	float diff = max(dot(normal, ray), 0.0);
-	vec4 diffuse = light.diffuse * (diff * mat.diffuse);
+layout(binding=8) readonly buffer DrawDataBuffer {
+    DrawData draws[];
+};
 
-	return (ambient + diffuse).xyz;
-}
+layout(push_constant) uniform MeshData {
+    uint draw_index;
+    uint material_index;
+};
 
 void main() {
-    Vertex v = vertices[gl_VertexIndex];
-    Material m = materials[material_index];
+    VertexPosition p = positions[gl_VertexIndex];
+    VertexAttributes a = attributes[gl_VertexIndex];
 
-    vec4 position = vec4(v.px, v.py, v.pz, 1.0);
-    vec4 normal = vec4(vec3(v.nx, v.ny, v.nz) / 127.0 - 1.0, 1.0);
-    vec2 tex_coord = vec2(v.tu, v.tv);
+    vec4 position = vec4(p.x, p.y, p.z, 1.0);
+    vec3 normal = vec3(a.nx, a.ny, a.nz) / 127.0 - 1.0;
 
-    vec4 world_pos = model_matrix * position;
-	vec3 norm = normalize(mat3(transpose(inverse(model_matrix))) * normal.xyz);
+    DrawData draw = draws[draw_index];
 
-    vec3 result = CalculateDirLight(dir_light, m, norm);
+    vec4 world_pos = draw.model_matrix * position;
+    vec4 view_pos = view_matrix * world_pos;
 
-	for (int i = 0; i < num_point_lights; i++) {
-		result += CalculatePointLight(point_lights[i], m, norm, world_pos.xyz);
-	}
+    out_world_pos = world_pos.xyz;
+	out_normal = mat3(transpose(inverse(draw.model_matrix))) * normal;
+    out_view_depth = -view_pos.z;
+    out_material_index = material_index;
+    out_tex_coord = vec2(a.tu, a.tv);
+    out_current_clip = view_projection * world_pos;
+    out_previous_clip = previous_view_projection * (draw.previous_model_matrix * position);
 
-	gl_Position = projection_matrix * view_matrix * world_pos;
-    frag_color = vec4(result, 1.0);
+	gl_Position = projection_matrix * view_pos;
 }
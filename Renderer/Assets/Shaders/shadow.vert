@@ -0,0 +1,20 @@
+#version 450
+
+// Depth only, reads nothing but the position stream
+
+struct VertexPosition {
+    float x, y, z;
+};
+
+layout(binding=0) readonly buffer VertexPositions {
+    VertexPosition positions[];
+};
+
+layout(push_constant) uniform ShadowMeshData {
+    mat4 light_model_matrix;
+};
+
+void main() {
+    VertexPosition p = positions[gl_VertexIndex];
+	gl_Position = light_model_matrix * vec4(p.x, p.y, p.z, 1.0);
+}
@@ -1,5 +1,8 @@
 #include "Common.h"
 
+#include <chrono>
+#include <filesystem>
+
 static void ColorReset(FILE *stream) {
 	printf("\x1b[0m");
 }
@@ -74,3 +77,53 @@ char *ReadEntireFile(const char *file_path) {
 
     return data;
 }
+
+u64 HashBytes(const void *data, u64 size, u64 hash) {
+    const u8 *bytes = (const u8 *) data;
+
+    for (u64 i = 0; i < size; ++i) {
+        hash ^= bytes[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+bool IsCookedFileUpToDate(const char *source_path, const char *cooked_path) {
+    std::error_code error;
+
+    auto cooked_time = std::filesystem::last_write_time(cooked_path, error);
+    if (error) return false;
+
+    auto source_time = std::filesystem::last_write_time(source_path, error);
+    if (error) return true;
+
+    if (cooked_time < source_time) return false;
+
+    // The AssetCooker lists the other files an output was built from next to it, one per line.
+    // Like the source, dependencies that aren't there are assumed not to have changed.
+    string dependencies_path = string(cooked_path) + ".deps";
+    FILE *file = fopen(dependencies_path.c_str(), "r");
+    if (!file) return true;
+
+    bool up_to_date = true;
+
+    char line[1024];
+    while (up_to_date && fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = 0;
+        if (!line[0]) continue;
+
+        auto dependency_time = std::filesystem::last_write_time(line, error);
+        up_to_date = error || cooked_time >= dependency_time;
+    }
+
+    fclose(file);
+
+    return up_to_date;
+}
+
+static std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+
+f64 GetTime() {
+    return std::chrono::duration<f64>(std::chrono::steady_clock::now() - start_time).count();
+}
@@ -2,6 +2,7 @@
 #define COMMON_H
 
 #include <stdarg.h>
+#include <stddef.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -55,4 +56,13 @@ void LogInfo(const char *format, ...);
 
 char *ReadEntireFile(const char *file_path);
 
+// FNV-1a, fine for cache keys and detecting changed inputs
+u64 HashBytes(const void *data, u64 size, u64 hash=0xcbf29ce484222325ull);
+
+// True if cooked_path exists and is at least as new as source_path and the dependencies listed in cooked_path.deps
+bool IsCookedFileUpToDate(const char *source_path, const char *cooked_path);
+
+// Seconds since startup, unlike glfwGetTime this works without a window
+f64 GetTime();
+
 #endif
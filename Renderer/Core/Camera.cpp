@@ -115,11 +115,12 @@ bool FreeCamera::Update(Window *window, f32 delta) {
 	bool right_click = Input::IsButtonDown(MouseButton::Right);
 	bool shift = Input::IsKeyDown(KeyCode::LeftShift);
 
-	if (Input::GetButton(MouseButton::Right) == InputState::Pressed) {
+	// Replays can run without a window
+	if (window && Input::GetButton(MouseButton::Right) == InputState::Pressed) {
 		window->SetHideCursor(true);
 	}
 
-	if (Input::GetButton(MouseButton::Right) == InputState::Released) {
+	if (window && Input::GetButton(MouseButton::Right) == InputState::Released) {
 		window->SetHideCursor(false);
 	}
 
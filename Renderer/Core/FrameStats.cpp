@@ -0,0 +1,101 @@
+#include "FrameStats.h"
+
+static u32 BucketIndex(f64 ms) {
+    u64 us = u64(ms * 1000.0);
+    us = us < 1 ? 1 : us;
+
+    u32 octave = 0;
+    while ((us >> (octave + 1)) != 0) {
+        octave++;
+    }
+    if (octave >= FRAME_STATS_OCTAVES) {
+        return FRAME_STATS_OCTAVES * FRAME_STATS_SUB_BUCKETS - 1;
+    }
+
+    u64 base = 1ull << octave;
+    u32 sub = u32((us - base) * FRAME_STATS_SUB_BUCKETS / base);
+
+    return octave * FRAME_STATS_SUB_BUCKETS + sub;
+}
+
+static f64 BucketUpperBound(u32 index) {
+    u32 octave = index / FRAME_STATS_SUB_BUCKETS;
+    u32 sub = index % FRAME_STATS_SUB_BUCKETS;
+
+    f64 base = f64(1ull << octave);
+    return (base + base * f64(sub + 1) / f64(FRAME_STATS_SUB_BUCKETS)) / 1000.0;
+}
+
+void FrameTimeHistogram::Add(f64 ms) {
+    counts[BucketIndex(ms)]++;
+    total++;
+}
+
+f64 FrameTimeHistogram::Percentile(f64 p) {
+    if (total == 0) {
+        return 0.0;
+    }
+
+    // Rank of the sample at the percentile, counted from 1
+    u64 rank = u64(p / 100.0 * f64(total) + 0.5);
+    rank = rank < 1 ? 1 : rank > total ? total : rank;
+
+    u64 seen = 0;
+    for (u32 i = 0; i < ARRAY_SIZE(counts); ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            return BucketUpperBound(i);
+        }
+    }
+
+    return BucketUpperBound(ARRAY_SIZE(counts) - 1);
+}
+
+void FrameTimeHistogram::Reset() {
+    memset(counts, 0, sizeof(counts));
+    total = 0;
+}
+
+void FrameTimeStats::Add(f64 ms) {
+    ring[frame_count % FRAME_STATS_RING_SIZE] = ms;
+    frame_count++;
+
+    histogram.Add(ms);
+    total += ms;
+    max = ms > max ? ms : max;
+
+    if (ms > hitch_threshold) {
+        hitches++;
+    }
+}
+
+f64 FrameTimeStats::GetRecent(u64 index) {
+    return ring[(frame_count - 1 - index) % FRAME_STATS_RING_SIZE];
+}
+
+u64 FrameTimeStats::GetRecentCount() {
+    return frame_count < FRAME_STATS_RING_SIZE ? frame_count : FRAME_STATS_RING_SIZE;
+}
+
+FrameTimeSummary FrameTimeStats::Summarize() {
+    FrameTimeSummary summary = {};
+    summary.frames = frame_count;
+    summary.mean = frame_count ? total / f64(frame_count) : 0.0;
+    summary.p50 = histogram.Percentile(50.0);
+    summary.p95 = histogram.Percentile(95.0);
+    summary.p99 = histogram.Percentile(99.0);
+    summary.p999 = histogram.Percentile(99.9);
+    // Exact, the histogram would round it up to its bucket
+    summary.max = max;
+    summary.hitches = hitches;
+
+    return summary;
+}
+
+void FrameTimeStats::Reset() {
+    frame_count = 0;
+    histogram.Reset();
+    total = 0.0;
+    max = 0.0;
+    hitches = 0;
+}
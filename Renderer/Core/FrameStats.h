@@ -0,0 +1,56 @@
+#ifndef FRAME_STATS_H
+#define FRAME_STATS_H
+
+#include "../Common.h"
+
+// Last frames kept with their exact times, for the CSV export
+#define FRAME_STATS_RING_SIZE 4096
+
+// Log-linear buckets over microseconds: every power of two is split into
+// FRAME_STATS_SUB_BUCKETS linear steps, so percentiles are within ~3% of the
+// real value from 1us up to FRAME_STATS_OCTAVES powers of two (~16 seconds)
+#define FRAME_STATS_SUB_BUCKETS 32
+#define FRAME_STATS_OCTAVES     24
+
+struct FrameTimeHistogram {
+    u64 counts[FRAME_STATS_OCTAVES * FRAME_STATS_SUB_BUCKETS] = {};
+    u64 total = 0;
+
+    void Add(f64 ms);
+    // Upper bound of the bucket holding the percentile, p in 0..100
+    f64 Percentile(f64 p);
+    void Reset();
+};
+
+struct FrameTimeSummary {
+    u64 frames;
+    f64 mean;
+    f64 p50;
+    f64 p95;
+    f64 p99;
+    f64 p999;
+    f64 max;
+    u64 hitches;
+};
+
+// Every frame time since the last reset goes into the histogram, the exact
+// ones of the last FRAME_STATS_RING_SIZE frames also into a ring
+struct FrameTimeStats {
+    f64 ring[FRAME_STATS_RING_SIZE] = {};
+    u64 frame_count = 0;
+    FrameTimeHistogram histogram;
+    f64 total = 0.0;
+    f64 max = 0.0;
+    // Frames slower than this count as hitches
+    f64 hitch_threshold = 33.3;
+    u64 hitches = 0;
+
+    void Add(f64 ms);
+    // Most recent is index 0
+    f64 GetRecent(u64 index);
+    u64 GetRecentCount();
+    FrameTimeSummary Summarize();
+    void Reset();
+};
+
+#endif
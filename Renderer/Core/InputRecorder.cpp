@@ -0,0 +1,169 @@
+#include "InputRecorder.h"
+
+#define INPUT_RECORDING_MAGIC 0x43455249 // "IREC"
+
+InputRecorderMode InputRecorder::mode = InputRecorderMode::None;
+string InputRecorder::path;
+array<InputFrame> InputRecorder::frames;
+u32 InputRecorder::frame_index = 0;
+
+void InputRecorder::StartRecording(const char *path) {
+    InputRecorder::path = path;
+    mode = InputRecorderMode::Record;
+    frames.clear();
+    frame_index = 0;
+
+    LogInfo("Recording input to %s", path);
+}
+
+bool InputRecorder::StartReplay(const char *path) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        LogError("Failed to open input recording %s", path);
+        return false;
+    }
+
+    u32 header[4];
+    bool valid = fread(header, sizeof(header), 1, file) == 1 &&
+        header[0] == INPUT_RECORDING_MAGIC &&
+        header[1] == INPUT_RECORDING_VERSION &&
+        header[2] == sizeof(Event);
+
+    if (!valid) {
+        LogError("Input recording %s is from a different version", path);
+        fclose(file);
+        return false;
+    }
+
+    frames.resize(header[3]);
+
+    for (InputFrame &frame : frames) {
+        u32 event_count = 0;
+
+        valid = fread(&frame.delta_time, sizeof(frame.delta_time), 1, file) == 1 &&
+            fread(frame.keys, sizeof(frame.keys), 1, file) == 1 &&
+            fread(frame.buttons, sizeof(frame.buttons), 1, file) == 1 &&
+            fread(&frame.mouse_pos, sizeof(frame.mouse_pos), 1, file) == 1 &&
+            fread(&frame.delta_mouse_pos, sizeof(frame.delta_mouse_pos), 1, file) == 1 &&
+            fread(&frame.scroll, sizeof(frame.scroll), 1, file) == 1 &&
+            fread(&frame.locked, sizeof(frame.locked), 1, file) == 1 &&
+            fread(&event_count, sizeof(event_count), 1, file) == 1;
+
+        if (!valid) {
+            break;
+        }
+
+        frame.events.resize(event_count);
+        if (event_count > 0 && fread(frame.events.data(), sizeof(Event), event_count, file) != event_count) {
+            valid = false;
+            break;
+        }
+    }
+
+    fclose(file);
+
+    if (!valid) {
+        LogError("Input recording %s is truncated", path);
+        frames.clear();
+        return false;
+    }
+
+    InputRecorder::path = path;
+    mode = InputRecorderMode::Replay;
+    frame_index = 0;
+
+    LogInfo("Replaying %u frames from %s", u32(frames.size()), path);
+    return true;
+}
+
+void InputRecorder::Stop() {
+    if (mode != InputRecorderMode::Record) {
+        mode = InputRecorderMode::None;
+        return;
+    }
+
+    mode = InputRecorderMode::None;
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        LogError("Failed to write input recording %s", path.c_str());
+        return;
+    }
+
+    u32 header[4] = { INPUT_RECORDING_MAGIC, INPUT_RECORDING_VERSION, u32(sizeof(Event)), u32(frames.size()) };
+    fwrite(header, sizeof(header), 1, file);
+
+    for (InputFrame &frame : frames) {
+        u32 event_count = u32(frame.events.size());
+
+        fwrite(&frame.delta_time, sizeof(frame.delta_time), 1, file);
+        fwrite(frame.keys, sizeof(frame.keys), 1, file);
+        fwrite(frame.buttons, sizeof(frame.buttons), 1, file);
+        fwrite(&frame.mouse_pos, sizeof(frame.mouse_pos), 1, file);
+        fwrite(&frame.delta_mouse_pos, sizeof(frame.delta_mouse_pos), 1, file);
+        fwrite(&frame.scroll, sizeof(frame.scroll), 1, file);
+        fwrite(&frame.locked, sizeof(frame.locked), 1, file);
+        fwrite(&event_count, sizeof(event_count), 1, file);
+        fwrite(frame.events.data(), sizeof(Event), event_count, file);
+    }
+
+    fclose(file);
+
+    LogInfo("Wrote %u recorded frames to %s", u32(frames.size()), path.c_str());
+}
+
+void InputRecorder::Frame(Engine *engine, f32 *delta_time) {
+    if (mode == InputRecorderMode::Record) {
+        InputFrame frame;
+        frame.delta_time = *delta_time;
+        frame.mouse_pos = Input::mouse_pos;
+        frame.delta_mouse_pos = Input::delta_mouse_pos;
+        frame.scroll = Input::scroll;
+        frame.locked = Input::locked;
+
+        for (u32 i = 0; i < MAX_KEYS; ++i) {
+            frame.keys[i] = u8(Input::keys[i]);
+        }
+        for (u32 i = 0; i < MAX_BUTTONS; ++i) {
+            frame.buttons[i] = u8(Input::buttons[i]);
+        }
+
+        // The queue is consumed by the frame, go through a copy
+        queue<Event> events = engine->events;
+        while (!events.empty()) {
+            frame.events.push_back(events.front());
+            events.pop();
+        }
+
+        frames.push_back(frame);
+    } else if (mode == InputRecorderMode::Replay && frame_index < frames.size()) {
+        InputFrame *frame = &frames[frame_index++];
+
+        *delta_time = frame->delta_time;
+        Input::mouse_pos = frame->mouse_pos;
+        Input::delta_mouse_pos = frame->delta_mouse_pos;
+        Input::scroll = frame->scroll;
+        Input::locked = frame->locked;
+
+        for (u32 i = 0; i < MAX_KEYS; ++i) {
+            Input::keys[i] = InputState(frame->keys[i]);
+        }
+        for (u32 i = 0; i < MAX_BUTTONS; ++i) {
+            Input::buttons[i] = InputState(frame->buttons[i]);
+        }
+
+        // Live window events are dropped, only the recorded ones are handled
+        engine->events = queue<Event>();
+        for (Event &event : frame->events) {
+            engine->events.push(event);
+        }
+    }
+}
+
+bool InputRecorder::IsReplaying() {
+    return mode == InputRecorderMode::Replay;
+}
+
+bool InputRecorder::IsReplayFinished() {
+    return mode == InputRecorderMode::Replay && frame_index >= frames.size();
+}
@@ -0,0 +1,50 @@
+#ifndef INPUT_RECORDER_H
+#define INPUT_RECORDER_H
+
+#include "../Common.h"
+#include "Engine.h"
+#include "Input.h"
+
+// Bump when the layout of the recording file changes
+#define INPUT_RECORDING_VERSION 1
+
+// Everything a frame reads from the outside world
+struct InputFrame {
+    f32 delta_time;
+    u8 keys[MAX_KEYS];
+    u8 buttons[MAX_BUTTONS];
+    MousePos mouse_pos;
+    MousePos delta_mouse_pos;
+    f64 scroll;
+    bool locked;
+    array<Event> events;
+};
+
+enum class InputRecorderMode {
+    None,
+    Record,
+    Replay
+};
+
+// Records the engine events, the Input state and the delta time of every frame, or feeds
+// a recording back so two runs render exactly the same frame sequence.
+// Recordings store raw Event structs and are only meant to be replayed by the same build.
+struct InputRecorder {
+    static InputRecorderMode mode;
+    static string path;
+    static array<InputFrame> frames;
+    static u32 frame_index;
+
+    static void StartRecording(const char *path);
+    static bool StartReplay(const char *path);
+    // Writes the recording, if there is one
+    static void Stop();
+
+    // Call at the start of a frame, before the events are handled. Records the current state,
+    // or replaces the events, the Input state and delta_time with the recorded ones.
+    static void Frame(Engine *engine, f32 *delta_time);
+    static bool IsReplaying();
+    static bool IsReplayFinished();
+};
+
+#endif
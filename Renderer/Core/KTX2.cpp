@@ -0,0 +1,238 @@
+#include "KTX2.h"
+
+static const u8 KTX2_IDENTIFIER[12] = {
+    0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A
+};
+
+struct KTX2Header {
+    u8 identifier[12];
+    u32 vk_format;
+    u32 type_size;
+    u32 pixel_width;
+    u32 pixel_height;
+    u32 pixel_depth;
+    u32 layer_count;
+    u32 face_count;
+    u32 level_count;
+    u32 supercompression_scheme;
+
+    u32 dfd_byte_offset;
+    u32 dfd_byte_length;
+    u32 kvd_byte_offset;
+    u32 kvd_byte_length;
+    u64 sgd_byte_offset;
+    u64 sgd_byte_length;
+};
+
+struct KTX2LevelIndex {
+    u64 byte_offset;
+    u64 byte_length;
+    u64 uncompressed_byte_length;
+};
+
+static_assert(sizeof(KTX2Header) == 80, "KTX2 header must be tightly packed");
+
+// Khronos Data Format constants, see the KTX2 and KDFS specifications
+#define KDF_MODEL_RGBSDA        1
+#define KDF_MODEL_BC1A          128
+#define KDF_MODEL_BC5           132
+#define KDF_MODEL_BC7           134
+#define KDF_PRIMARIES_BT709     1
+#define KDF_TRANSFER_LINEAR     1
+#define KDF_TRANSFER_SRGB       2
+#define KDF_SAMPLE_LINEAR       0x10
+#define KDF_CHANNEL_ALPHA       15
+
+struct KTX2FormatInfo {
+    VkFormat format;
+    u32 model;
+    u32 block_dimension;
+    u32 block_bytes;
+    u32 type_size;
+    bool srgb;
+};
+
+static const KTX2FormatInfo KTX2_FORMATS[] = {
+    { VK_FORMAT_R8G8B8A8_UNORM,         KDF_MODEL_RGBSDA, 1, 4,  1, false },
+    { VK_FORMAT_R8G8B8A8_SRGB,          KDF_MODEL_RGBSDA, 1, 4,  1, true  },
+    { VK_FORMAT_BC1_RGB_UNORM_BLOCK,    KDF_MODEL_BC1A,   4, 8,  1, false },
+    { VK_FORMAT_BC1_RGB_SRGB_BLOCK,     KDF_MODEL_BC1A,   4, 8,  1, true  },
+    { VK_FORMAT_BC5_UNORM_BLOCK,        KDF_MODEL_BC5,    4, 16, 1, false },
+    { VK_FORMAT_BC7_UNORM_BLOCK,        KDF_MODEL_BC7,    4, 16, 1, false },
+    { VK_FORMAT_BC7_SRGB_BLOCK,         KDF_MODEL_BC7,    4, 16, 1, true  },
+};
+
+static const KTX2FormatInfo *GetFormatInfo(VkFormat format) {
+    for (const KTX2FormatInfo &info : KTX2_FORMATS) {
+        if (info.format == format) {
+            return &info;
+        }
+    }
+    return 0;
+}
+
+struct KTX2Sample {
+    u32 bit_offset;
+    u32 bit_length;
+    u32 channel;
+    u32 upper;
+};
+
+static void BuildDataFormatDescriptor(const KTX2FormatInfo *info, array<u32> *dfd) {
+    array<KTX2Sample> samples;
+    u32 alpha_channel = KDF_CHANNEL_ALPHA | (info->srgb ? KDF_SAMPLE_LINEAR : 0);
+
+    switch (info->model) {
+        case KDF_MODEL_RGBSDA:
+            samples = {
+                { 0, 8, 0, 255 },
+                { 8, 8, 1, 255 },
+                { 16, 8, 2, 255 },
+                { 24, 8, alpha_channel, 255 }
+            };
+            break;
+        case KDF_MODEL_BC1A:
+            samples = { { 0, 64, 0, 0xFFFFFFFF } };
+            break;
+        case KDF_MODEL_BC5:
+            samples = { { 0, 64, 0, 0xFFFFFFFF }, { 64, 64, 1, 0xFFFFFFFF } };
+            break;
+        case KDF_MODEL_BC7:
+            samples = { { 0, 128, 0, 0xFFFFFFFF } };
+            break;
+    }
+
+    const u32 block_size = 24 + 16 * u32(samples.size());
+    const u32 dimension = info->block_dimension - 1;
+
+    dfd->push_back(4 + block_size);
+    dfd->push_back(0);
+    dfd->push_back(2 | (block_size << 16));
+    dfd->push_back(info->model | (KDF_PRIMARIES_BT709 << 8) | ((info->srgb ? KDF_TRANSFER_SRGB : KDF_TRANSFER_LINEAR) << 16));
+    dfd->push_back(dimension | (dimension << 8));
+    dfd->push_back(info->block_bytes);
+    dfd->push_back(0);
+
+    for (KTX2Sample &sample : samples) {
+        dfd->push_back(sample.bit_offset | ((sample.bit_length - 1) << 16) | (sample.channel << 24));
+        dfd->push_back(0);
+        dfd->push_back(0);
+        dfd->push_back(sample.upper);
+    }
+}
+
+static u64 AlignUp(u64 value, u64 alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+bool KTX2Texture::Load(const char *path, u32 first_level, u32 end_level) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+
+    KTX2Header header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1;
+
+    ok = ok && memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0;
+    ok = ok && header.supercompression_scheme == 0;
+    ok = ok && header.pixel_depth == 0 && header.layer_count == 0 && header.face_count == 1;
+    ok = ok && header.level_count > 0;
+
+    array<KTX2LevelIndex> level_index;
+    if (ok) {
+        level_index.resize(header.level_count);
+        ok = fread(level_index.data(), sizeof(KTX2LevelIndex), header.level_count, file) == header.level_count;
+    }
+
+    if (ok) {
+        format = VkFormat(header.vk_format);
+        width = header.pixel_width;
+        height = header.pixel_height;
+        levels.resize(header.level_count);
+        level_sizes.resize(header.level_count);
+
+        for (u32 i = 0; i < header.level_count; ++i) {
+            level_sizes[i] = level_index[i].byte_length;
+        }
+
+        if (end_level > header.level_count) {
+            end_level = header.level_count;
+        }
+
+        for (u32 i = first_level; ok && i < end_level; ++i) {
+            levels[i].resize(level_index[i].byte_length);
+
+            ok = fseek(file, long(level_index[i].byte_offset), SEEK_SET) == 0;
+            ok = ok && fread(levels[i].data(), 1, level_index[i].byte_length, file) == level_index[i].byte_length;
+        }
+    }
+
+    fclose(file);
+
+    if (!ok) {
+        LogError("Invalid or unsupported KTX2 file '%s'", path);
+    }
+
+    return ok;
+}
+
+bool KTX2Texture::Save(const char *path) {
+    const KTX2FormatInfo *info = GetFormatInfo(format);
+    if (!info) {
+        LogError("Unsupported KTX2 format %d for '%s'", format, path);
+        return false;
+    }
+
+    array<u32> dfd;
+    BuildDataFormatDescriptor(info, &dfd);
+
+    u32 level_count = u32(levels.size());
+
+    KTX2Header header = {};
+    memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+    header.vk_format = format;
+    header.type_size = info->type_size;
+    header.pixel_width = width;
+    header.pixel_height = height;
+    header.face_count = 1;
+    header.level_count = level_count;
+    header.dfd_byte_offset = u32(sizeof(KTX2Header) + level_count * sizeof(KTX2LevelIndex));
+    header.dfd_byte_length = u32(dfd.size() * sizeof(u32));
+
+    // Mip levels are stored smallest first, each aligned to lcm(block size, 4)
+    u64 alignment = info->block_bytes < 4 ? 4 : info->block_bytes;
+    u64 offset = header.dfd_byte_offset + header.dfd_byte_length;
+
+    array<KTX2LevelIndex> level_index(level_count);
+    for (s32 i = s32(level_count) - 1; i >= 0; --i) {
+        offset = AlignUp(offset, alignment);
+
+        level_index[i].byte_offset = offset;
+        level_index[i].byte_length = levels[i].size();
+        level_index[i].uncompressed_byte_length = levels[i].size();
+
+        offset += levels[i].size();
+    }
+
+    FILE *file = fopen(path, "wb");
+    if (!file) return false;
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(level_index.data(), sizeof(KTX2LevelIndex), level_count, file);
+    fwrite(dfd.data(), sizeof(u32), dfd.size(), file);
+
+    for (s32 i = s32(level_count) - 1; i >= 0; --i) {
+        static const u8 padding[16] = {};
+        u64 position = u64(ftell(file));
+        fwrite(padding, 1, level_index[i].byte_offset - position, file);
+        fwrite(levels[i].data(), 1, levels[i].size(), file);
+    }
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+
+    return ok;
+}
+
+void KTX2Texture::AddLevel(const u8 *data, u64 size) {
+    levels.emplace_back(data, data + size);
+}
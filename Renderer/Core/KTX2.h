@@ -0,0 +1,26 @@
+#ifndef KTX2_H
+#define KTX2_H
+
+#include <vulkan/vulkan.h>
+
+#include "../Common.h"
+
+// Minimal KTX 2.0 container reader/writer. Supports single layer, single face
+// 2D textures without supercompression, which is all the AssetCooker produces.
+struct KTX2Texture {
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    u32 width = 0;
+    u32 height = 0;
+    // levels[0] is the full resolution image
+    array<array<u8>> levels;
+    // Byte size of every level, also of the ones that weren't read
+    array<u64> level_sizes;
+
+    // Only levels in [first_level, end_level) are read, the others are left empty
+    bool Load(const char *path, u32 first_level=0, u32 end_level=~0u);
+    bool Save(const char *path);
+
+    void AddLevel(const u8 *data, u64 size);
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "Profiler.h"
+
+#ifndef VULKAN_RENDERER_DIST
+#include <chrono>
+#include <mutex>
+
+static std::chrono::steady_clock::time_point profiler_start = std::chrono::steady_clock::now();
+
+static std::mutex threads_mutex;
+static array<ProfileThread *> threads;
+static thread_local ProfileThread *current_thread = 0;
+
+// Threads are registered on their first event and never freed, the trace may be written after they exited
+static ProfileThread *GetThread() {
+    if (!current_thread) {
+        ProfileThread *thread = new ProfileThread();
+        thread->events = new ProfileEvent[PROFILER_RING_SIZE];
+        thread->count = 0;
+
+        std::lock_guard<std::mutex> lock(threads_mutex);
+        thread->id = u32(threads.size());
+        thread->name = "Thread " + std::to_string(thread->id);
+        threads.push_back(thread);
+
+        current_thread = thread;
+    }
+
+    return current_thread;
+}
+
+u64 Profiler::Now() {
+    return u64(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - profiler_start).count());
+}
+
+void Profiler::Record(const char *name, u64 begin, u64 end) {
+    ProfileThread *thread = GetThread();
+
+    u64 count = thread->count.load(std::memory_order_relaxed);
+    thread->events[count % PROFILER_RING_SIZE] = { name, begin, end };
+    thread->count.store(count + 1, std::memory_order_release);
+}
+
+void Profiler::SetThreadName(const char *name) {
+    ProfileThread *thread = GetThread();
+
+    std::lock_guard<std::mutex> lock(threads_mutex);
+    thread->name = name;
+}
+
+void Profiler::WriteTrace(const char *file_path) {
+    FILE *file = fopen(file_path, "w");
+    if (!file) {
+        LogError("Failed to open %s for the CPU trace", file_path);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(threads_mutex);
+
+    fprintf(file, "{\"traceEvents\":[\n");
+    bool first = true;
+
+    for (ProfileThread *thread : threads) {
+        fprintf(file, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}", first ? "" : ",\n", thread->id, thread->name.c_str());
+        first = false;
+
+        // Other threads keep recording, leave them some room so the oldest events aren't overwritten while reading
+        u64 count = thread->count.load(std::memory_order_acquire);
+        u64 available = PROFILER_RING_SIZE - 1024;
+        u64 start = count > available ? count - available : 0;
+
+        for (u64 i = start; i < count; ++i) {
+            ProfileEvent event = thread->events[i % PROFILER_RING_SIZE];
+
+            fprintf(
+                file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                event.name, thread->id, f64(event.begin) * 1e-3, f64(event.end - event.begin) * 1e-3
+            );
+        }
+    }
+
+    fprintf(file, "\n]}\n");
+    fclose(file);
+
+    LogInfo("Wrote CPU trace to %s", file_path);
+}
+#else
+u64 Profiler::Now() { return 0; }
+void Profiler::Record(const char *name, u64 begin, u64 end) {}
+void Profiler::SetThreadName(const char *name) {}
+void Profiler::WriteTrace(const char *file_path) {}
+#endif
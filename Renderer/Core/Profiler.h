@@ -0,0 +1,63 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <atomic>
+
+#include "../Common.h"
+
+// Events kept per thread, older ones are overwritten
+#define PROFILER_RING_SIZE 65536
+
+struct ProfileEvent {
+    const char *name;
+    // Nanoseconds since the profiler started
+    u64 begin;
+    u64 end;
+};
+
+// Written only by its own thread, read by WriteTrace
+struct ProfileThread {
+    u32 id;
+    string name;
+    ProfileEvent *events;
+    // Total number of events ever written, the ring index is this modulo PROFILER_RING_SIZE
+    std::atomic<u64> count;
+};
+
+// Scoped CPU profiler. Every thread records into its own ring buffer without locking,
+// WriteTrace dumps all of them as a Chrome trace_event file for chrome://tracing or Perfetto.
+// Everything is compiled out in Dist.
+struct Profiler {
+    static u64 Now();
+    static void Record(const char *name, u64 begin, u64 end);
+    static void SetThreadName(const char *name);
+
+    static void WriteTrace(const char *file_path);
+};
+
+struct ProfileScope {
+    const char *name;
+    u64 begin;
+
+    ProfileScope(const char *name) : name(name) {
+        begin = Profiler::Now();
+    }
+
+    ~ProfileScope() {
+        Profiler::Record(name, begin, Profiler::Now());
+    }
+};
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing block, name has to be a string literal
+#ifndef VULKAN_RENDERER_DIST
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__func__)
+#else
+#define PROFILE_SCOPE(name)
+#define PROFILE_FUNCTION()
+#endif
+
+#endif
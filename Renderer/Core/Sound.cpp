@@ -22,8 +22,15 @@ void Sound::Play() {
     ma_sound_start(&handle);
 }
 
-void InitSound() {
-    ma_result result = ma_engine_init(0, &engine);
+void InitSound(bool no_device) {
+    ma_engine_config config = ma_engine_config_init();
+    if (no_device) {
+        config.noDevice = MA_TRUE;
+        config.channels = 2;
+        config.sampleRate = 48000;
+    }
+
+    ma_result result = ma_engine_init(&config, &engine);
 
     if (result != MA_SUCCESS) {
         LogFatal("Failed to initialize audio engine");
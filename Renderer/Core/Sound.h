@@ -14,7 +14,8 @@ struct Sound {
     void Play();
 };
 
-void InitSound();
+// Without a device sounds are mixed but never played, for machines without audio output
+void InitSound(bool no_device=false);
 void DeinitSound();
 
 #endif
\ No newline at end of file
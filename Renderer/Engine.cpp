@@ -3,7 +3,11 @@
 #include "Core/Window.h"
 #include "Core/Input.h"
 
-Engine::Engine() {
+Engine::Engine(bool headless) {
+    if (headless) {
+        return;
+    }
+
     window = new Window("Engine", 1280, 720);
     window->SetEngine(this);
 }
@@ -17,6 +21,10 @@ void Engine::Start() {
 }
 
 void Engine::Update() {
+    if (!window) {
+        return;
+    }
+
     window->Update();
         
     if (window->ShouldClose()) {
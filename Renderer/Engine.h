@@ -39,7 +39,8 @@ struct Engine {
     Window *window = 0;
     bool running = true;
     
-    Engine();
+    // Headless engines have no window, nothing but running is updated
+    Engine(bool headless=false);
     ~Engine();
 
     void Start();
@@ -0,0 +1,29 @@
+#include "DynamicResolution.h"
+
+f32 DynamicResolution::Update(f64 gpu_frame_time) {
+    if (!enabled || gpu_frame_time <= 0.0) {
+        scale = enabled ? scale : max_scale;
+        return scale;
+    }
+
+    // Relative headroom, positive means there is time left to render more pixels
+    f32 error = f32((target_frame_time - gpu_frame_time) / target_frame_time);
+    if (error < -1.0f) error = -1.0f;
+
+    f32 delta = kp * (error - previous_error) + ki * error + kd * (error - 2.0f * previous_error + previous_error_2);
+
+    previous_error_2 = previous_error;
+    previous_error = error;
+
+    scale += delta;
+    if (scale < min_scale) scale = min_scale;
+    if (scale > max_scale) scale = max_scale;
+
+    return scale;
+}
+
+void DynamicResolution::Reset() {
+    scale = max_scale;
+    previous_error = 0.0f;
+    previous_error_2 = 0.0f;
+}
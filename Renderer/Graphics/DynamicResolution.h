@@ -0,0 +1,28 @@
+#ifndef DYNAMIC_RESOLUTION_H
+#define DYNAMIC_RESOLUTION_H
+
+#include "Common.h"
+
+// PID controller that picks the render scale from the measured GPU frame time.
+// Works in velocity form: the output is a change of scale, which gets clamped,
+// so the integral can't wind up while the scale sits at a limit.
+struct DynamicResolution {
+    bool enabled = true;
+    f64 target_frame_time = 15.0;
+    f32 min_scale = 0.5f;
+    f32 max_scale = 1.0f;
+
+    f32 kp = 0.10f;
+    f32 ki = 0.05f;
+    f32 kd = 0.02f;
+
+    f32 scale = 1.0f;
+    f32 previous_error = 0.0f;
+    f32 previous_error_2 = 0.0f;
+
+    // Returns the scale for the next frame, gpu_frame_time is the last frame in milliseconds
+    f32 Update(f64 gpu_frame_time);
+    void Reset();
+};
+
+#endif
@@ -1,29 +1,62 @@
 #include "MasterRenderer.h"
 
 MasterRenderer::MasterRenderer(RenderPass *render_pass) : render_pass(render_pass) {
-    RenderStats::Create();
+    RenderStats::Create(render_pass->frames_in_flight);
+    GPUFrameTimer::Create(render_pass->frames_in_flight);
+
+    temporal_upsampler = new TemporalUpsampler(render_pass);
 }
 
 MasterRenderer::~MasterRenderer() {
     RenderStats::Destroy();
+    GPUFrameTimer::Destroy();
+
+    delete temporal_upsampler;
 
     render_images.Destroy();
 }
 
 VkCommandBuffer MasterRenderer::Begin() {
-    cmd_buf = render_pass->BeginFrame(&render_images);
+    PipelineCompiler::Update();
 
-    RenderStats::Begin(cmd_buf);
+    // The upsampled result is blitted to the swapchain
+    if (!render_pass->blit_supported) {
+        temporal_upsampler->enabled = false;
+    }
 
-    render_pass->Begin(&render_images);
+    dynamic_resolution.max_scale = temporal_upsampler->enabled ? temporal_upsampler->max_scale : 1.0f;
+    // Not RenderStats::gpu_frame_time, the GPUProfiler is compiled out of Dist builds
+    render_pass->render_scale = dynamic_resolution.Update(GPUFrameTimer::frame_time);
+
+    cmd_buf = render_pass->BeginFrame(&render_images);
+    temporal_upsampler->Begin();
+
+    GPUFrameTimer::Begin(cmd_buf, render_pass->current_frame);
+    RenderStats::Begin(cmd_buf, render_pass->current_frame);
+    DefragmentVulkanMemory(cmd_buf, render_pass->frames_in_flight);
 
     return cmd_buf;
 }
 
+void MasterRenderer::BeginPass() {
+    render_pass->Begin(&render_images);
+}
+
 void MasterRenderer::End() {
-    render_pass->End(&render_images);
+    if (temporal_upsampler->enabled) {
+        render_pass->EndRendering();
+
+        Image *output = temporal_upsampler->Resolve(cmd_buf, &render_images);
+
+        GPU_SCOPE(cmd_buf, "Present");
+        render_pass->Present(output, render_pass->swapchain->extent);
+    } else {
+        GPU_SCOPE(cmd_buf, "Present");
+        render_pass->End(&render_images);
+    }
 
     RenderStats::EndGPU(cmd_buf);
+    GPUFrameTimer::End(cmd_buf);
 
     render_pass->EndFrame();
 
@@ -2,17 +2,23 @@
 #define MASTER_RENDERER_H
 
 #include "Vulkan/VulkanRenderer.h"
+#include "Graphics/DynamicResolution.h"
+#include "Graphics/TemporalUpsampler.h"
 
 struct MasterRenderer {
     RenderPass *render_pass;
     VkCommandBuffer cmd_buf;
 
     RenderImages render_images;
+    DynamicResolution dynamic_resolution;
+    TemporalUpsampler *temporal_upsampler;
 
     MasterRenderer(RenderPass *render_pass);
     ~MasterRenderer();
 
+    // Begins the frame, compute work goes between Begin and BeginPass
     VkCommandBuffer Begin();
+    void BeginPass();
     void End();
 };
 
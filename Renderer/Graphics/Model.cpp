@@ -1,124 +1,159 @@
 #include "Model.h"
 
-#include "assimp/Importer.hpp"
-#include "assimp/scene.h"
-#include "assimp/postprocess.h"
-
 #include "Common.h"
 
+#include <filesystem>
+
+TextureStreamer *ModelImporter::texture_streamer = 0;
+
 Model::Model() {
 }
 
 Model::~Model() {
+    Unload();
+    delete cpu_copy;
+}
+
+void Model::Upload(CookedModel *data, VkCommandPool command_pool) {
+    gpu_bytes = 0;
+
+    if (!data->materials.empty()) {
+		materials_buffer = new StorageBuffer();
+		materials_buffer->Create(data->materials.data(), data->materials.size() * sizeof(Material), command_pool);
+        gpu_bytes += materials_buffer->size;
+    }
+
+    // Only the detailed levels of a texture are ever evicted, the streamer keeps it when the model is unloaded
+    array<StreamedTexture *> textures(data->materials.size(), 0);
+    if (ModelImporter::texture_streamer) {
+        for (u64 i = 0; i < data->textures.size() && i < textures.size(); ++i) {
+            if (!data->textures[i].empty()) {
+                textures[i] = ModelImporter::texture_streamer->Load(data->textures[i].c_str());
+            }
+        }
+    }
+
+    meshes.resize(data->meshes.size());
+	for (u64 i = 0; i < data->meshes.size(); ++i) {
+		CookedMesh *cooked_mesh = &data->meshes[i];
+
+        StorageBuffer *positions_buffer = new StorageBuffer();
+        positions_buffer->Create(cooked_mesh->positions.data(), cooked_mesh->positions.size() * sizeof(VertexPosition), command_pool, MemoryCategory::Geometry);
+
+        StorageBuffer *attributes_buffer = new StorageBuffer();
+        attributes_buffer->Create(cooked_mesh->attributes.data(), cooked_mesh->attributes.size() * sizeof(VertexAttributes), command_pool, MemoryCategory::Geometry);
+
+        IndexBuffer *index_buffer = new IndexBuffer();
+        index_buffer->Create(cooked_mesh->indices.data(), u32(cooked_mesh->indices.size()), command_pool);
+		
+		Mesh *mesh = new Mesh;
+		mesh->material_index	= cooked_mesh->material_index;
+		mesh->positions_buffer  = positions_buffer;
+		mesh->attributes_buffer = attributes_buffer;
+		mesh->index_buffer		= index_buffer;
+        mesh->texture           = cooked_mesh->material_index < textures.size() ? textures[cooked_mesh->material_index] : 0;
+		meshes[i]				= mesh;
+
+        gpu_bytes += positions_buffer->size + attributes_buffer->size + u64(index_buffer->count) * sizeof(u32);
+	}
+
+    resident = true;
+}
+
+void Model::Unload() {
 	for (Mesh *mesh : meshes) {
-        mesh->vertices_buffer->Destroy();
-		mesh->index_buffer->Destroy();
-		delete mesh->vertices_buffer;
+        mesh->positions_buffer->Release();
+        mesh->attributes_buffer->Release();
+		mesh->index_buffer->Release();
+		delete mesh->positions_buffer;
+		delete mesh->attributes_buffer;
 		delete mesh->index_buffer;
         delete mesh;
 	}
+    meshes.clear();
+
+	if (materials_buffer) {
+		materials_buffer->Release();
+		delete materials_buffer;
+        materials_buffer = 0;
+	}
 
-	materials_buffer->Destroy();
-	delete materials_buffer;
+    resident = false;
 }
 
-Model *ModelImporter::Load(const char *path, VkCommandPool command_pool) {
-    Assimp::Importer importer;
+static bool LoadModelData(const char *path, CookedModel *data) {
+    string cooked_path = string(path) + ".model";
+    bool loaded = IsCookedFileUpToDate(path, cooked_path.c_str()) && LoadCookedModel(cooked_path.c_str(), data);
 
-	const u32 import_flags =
-		aiProcess_CalcTangentSpace |
-		aiProcess_Triangulate |
-		aiProcess_JoinIdenticalVertices |
-		aiProcess_GenNormals |
-		aiProcess_GenUVCoords |
-		aiProcess_SortByPType |
-		aiProcess_OptimizeMeshes |
-		aiProcess_GlobalScale |
-		aiProcess_ValidateDataStructure;
+    if (!loaded && !ImportModel(path, data)) {
+        return false;
+    }
 
-    const aiScene *scene = importer.ReadFile(path, import_flags);
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    for (string &texture : data->textures) {
+        if (!texture.empty()) {
+            texture = (directory / texture).generic_string();
+        }
+    }
 
-	if (!scene) {
-		LogFatal("Failed to load model: %s", importer.GetErrorString());
-	}
+    return true;
+}
+
+Model *ModelImporter::Load(const char *path, VkCommandPool command_pool, bool keep_cpu_copy) {
+    CookedModel data;
+
+    if (!LoadModelData(path, &data)) {
+        LogFatal("Failed to load model '%s'", path);
+    }
+
+    Model *model = Create(&data, command_pool, keep_cpu_copy);
+    model->path = path;
+
+    return model;
+}
 
+Model *ModelImporter::Create(CookedModel *data, VkCommandPool command_pool, bool keep_cpu_copy) {
 	Model *model = new Model();
-    
-    if (scene->HasMaterials()) {
-        Material *materials = new Material[scene->mNumMaterials];
-
-        for (u64 i = 0; i < scene->mNumMaterials; ++i) {
-            aiMaterial *aiMat = scene->mMaterials[i];
-            
-            Material *mat = &materials[i];
-
-            aiColor3D ambient, diffuse, specular;
-            if (aiMat->Get(AI_MATKEY_COLOR_AMBIENT, ambient) == AI_SUCCESS) {
-                mat->ambient = glm::vec4(ambient.r, ambient.g, ambient.b, 1.0f);
-            }
-            if (aiMat->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse) == AI_SUCCESS) {
-                mat->diffuse = glm::vec4(diffuse.r, diffuse.g, diffuse.b, 1.0f);
-            }
-            if (aiMat->Get(AI_MATKEY_COLOR_SPECULAR, specular) == AI_SUCCESS) {
-                mat->specular = glm::vec4(specular.r, specular.g, specular.b, 1.0f);
-            }
-        }
 
-		model->materials_buffer = new StorageBuffer();
-		model->materials_buffer->Create(materials, scene->mNumMaterials * sizeof(Material), command_pool);
+    glm::vec3 bounds_min = glm::vec3(1e30f);
+    glm::vec3 bounds_max = glm::vec3(-1e30f);
+    for (CookedMesh &cooked_mesh : data->meshes) {
+        for (VertexPosition &position : cooked_mesh.positions) {
+            bounds_min = glm::min(bounds_min, glm::vec3(position.x, position.y, position.z));
+            bounds_max = glm::max(bounds_max, glm::vec3(position.x, position.y, position.z));
+        }
+    }
 
-		delete[] materials;
+    if (bounds_min.x <= bounds_max.x) {
+        model->bounds_center = (bounds_min + bounds_max) * 0.5f;
+        model->bounds_radius = glm::length(bounds_max - bounds_min) * 0.5f;
     }
 
-    model->meshes.resize(scene->mNumMeshes);
-	for (int i = 0; i < scene->mNumMeshes; ++i) {
-		aiMesh *ai_mesh = scene->mMeshes[i];
-
-		u32 vertices_count = ai_mesh->mNumVertices;
-		Vertex *vertices = new Vertex[vertices_count];
-
-		u32 num_indices = ai_mesh->mNumFaces * 3;
-		u32 *indices = new u32[num_indices];
-
-		aiVector3D zero_vector(0.0f);
-		for (u32 i = 0; i < ai_mesh->mNumVertices; ++i) {
-			aiVector3D pos = ai_mesh->mVertices[i];
-			aiVector3D tex_coords = ai_mesh->HasTextureCoords(0) ? ai_mesh->mTextureCoords[0][i] : zero_vector;
-			aiVector3D normal = ai_mesh->mNormals[i];
-
-            Vertex *vertex = &vertices[i];
-            vertex->position = glm::vec<3, f32>(pos.x, pos.y, pos.z);
-            vertex->normal = glm::vec<4, u8>(
-                normal.x * 127.0f + 127.0f,
-                normal.y * 127.0f + 127.0f,
-                normal.z * 127.0f + 127.0f,
-                1
-            );
-            vertex->tex_coord = glm::vec<2, f32>(tex_coords.x, tex_coords.y);
-        }
+    model->Upload(data, command_pool);
 
-		for (u32 i = 0; i < ai_mesh->mNumFaces; ++i) {
-			aiFace face = ai_mesh->mFaces[i];
-			indices[i * 3 + 0] = face.mIndices[0];
-			indices[i * 3 + 1] = face.mIndices[1];
-			indices[i * 3 + 2] = face.mIndices[2];
-		}
+    if (keep_cpu_copy) {
+        model->cpu_copy = new CookedModel(*data);
+    }
 
-        StorageBuffer *storage_buffer = new StorageBuffer();
-        storage_buffer->Create((void *) &vertices[0], ai_mesh->mNumVertices * sizeof(Vertex), command_pool);
+    return model;
+}
 
-        IndexBuffer *index_buffer = new IndexBuffer();
-        index_buffer->Create((u32 *) &indices[0], num_indices, command_pool);
-		
-		Mesh *mesh = new Mesh;
-		mesh->material_index	= ai_mesh->mMaterialIndex;
-		mesh->vertices_buffer   = storage_buffer;
-		mesh->index_buffer		= index_buffer;
-		model->meshes[i]		= mesh;
+bool ModelImporter::Reload(Model *model, VkCommandPool command_pool) {
+    if (model->resident) {
+        return true;
+    }
 
-		delete[] vertices;
-		delete[] indices;
-	}
+    if (model->cpu_copy) {
+        model->Upload(model->cpu_copy, command_pool);
+        return true;
+    }
 
-    return model;
-}
\ No newline at end of file
+    CookedModel data;
+    if (model->path.empty() || !LoadModelData(model->path.c_str(), &data)) {
+        LogError("Failed to reload model '%s'", model->path.c_str());
+        return false;
+    }
+
+    model->Upload(&data, command_pool);
+    return true;
+}
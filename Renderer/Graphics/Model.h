@@ -3,6 +3,8 @@
 
 #include "Common.h"
 #include "Vulkan/VulkanRenderer.h"
+#include "Graphics/ModelData.h"
+#include "Graphics/TextureStreamer.h"
 
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
@@ -18,13 +20,8 @@ struct alignas(16) PointLight {
     glm::vec4 ambient;
     glm::vec4 diffuse;
     glm::vec3 pos;
-    f32 _padding;
-};
-
-struct alignas(16) PointLights {
-    u32 count;
-    glm::vec3 _padding;
-    PointLight lights[10];
+    // The light fades out to zero here, clustered culling relies on it
+    f32 radius = 10.0f;
 };
 
 struct alignas(16) Transformation {
@@ -33,36 +30,68 @@ struct alignas(16) Transformation {
     glm::mat4 model;
 };
 
-struct alignas(16) Material {
-    glm::vec4 ambient;
-    glm::vec4 diffuse;
-    glm::vec4 specular;
-    f32 shininess;
-    glm::vec3 _padding;
-};
-
 struct Mesh {
-    StorageBuffer *vertices_buffer = 0;
+    StorageBuffer *positions_buffer = 0;
+    StorageBuffer *attributes_buffer = 0;
     IndexBuffer *index_buffer = 0;
     u32 material_index = 0;
+    // Owned by the TextureStreamer, 0 if the material has no diffuse texture
+    StreamedTexture *texture = 0;
 };
 
 struct MeshData {
-    glm::mat4 model_matrix;
+    u32 draw_index;
     u32 material_index;
 };
 
+// Per draw matrices, the previous one gives the motion vectors
+struct alignas(16) DrawData {
+    glm::mat4 model_matrix;
+    glm::mat4 previous_model_matrix;
+};
+
 struct Model {
     StorageBuffer *materials_buffer = 0;
 	array<Mesh *> meshes;
     glm::mat4 transformation;
 
+    // Bounding sphere in model space
+    glm::vec3 bounds_center = glm::vec3(0.0f);
+    f32 bounds_radius = 0.0f;
+
+    // Where the model can be loaded from again, empty for generated ones
+    string path;
+    // Kept when asked for on import, a faster way back than the file
+    CookedModel *cpu_copy = 0;
+
+    // Without its buffers the meshes are empty
+    bool resident = false;
+    u64 gpu_bytes = 0;
+    u64 last_used_frame = 0;
+
 	Model();
 	~Model();
+
+    // Creates the buffers of every mesh and the materials, textures come from ModelImporter::texture_streamer
+    void Upload(CookedModel *data, VkCommandPool command_pool);
+    // Releases all GPU buffers, frames in flight can still draw them. The bounds stay
+    void Unload();
+};
+
+struct DrawCommand {
+    Model *model;
+    glm::mat4 transformation;
 };
 
 struct ModelImporter {
-    static Model *Load(const char *path, VkCommandPool command_pool);
+    // Material textures are loaded through it, without one models are drawn untextured
+    static TextureStreamer *texture_streamer;
+
+    static Model *Load(const char *path, VkCommandPool command_pool, bool keep_cpu_copy=false);
+    // Uploads already imported or generated data
+    static Model *Create(CookedModel *data, VkCommandPool command_pool, bool keep_cpu_copy=false);
+    // Uploads an unloaded model again, from its CPU copy or from its file
+    static bool Reload(Model *model, VkCommandPool command_pool);
 };
 
 #endif
@@ -0,0 +1,236 @@
+#include "ModelData.h"
+
+#include "assimp/DefaultIOSystem.h"
+#include "assimp/Importer.hpp"
+#include "assimp/scene.h"
+#include "assimp/postprocess.h"
+
+#define COOKED_MODEL_MAGIC 0x444D5256 // "VRMD"
+
+struct CookedModelHeader {
+    u32 magic;
+    u32 version;
+    u32 material_count;
+    u32 mesh_count;
+};
+
+struct CookedMeshHeader {
+    u32 material_index;
+    u32 vertex_count;
+    u32 index_count;
+};
+
+// Remembers every file the importer opens
+struct RecordingIOSystem : Assimp::DefaultIOSystem {
+    array<string> *opened;
+
+    RecordingIOSystem(array<string> *opened) : opened(opened) {}
+
+    Assimp::IOStream *Open(const char *file, const char *mode) override {
+        Assimp::IOStream *stream = DefaultIOSystem::Open(file, mode);
+        if (stream) {
+            opened->push_back(file);
+        }
+        return stream;
+    }
+};
+
+bool ImportModel(const char *path, CookedModel *model, array<string> *dependencies) {
+    Assimp::Importer importer;
+
+    array<string> opened;
+    if (dependencies) {
+        // The importer takes ownership
+        importer.SetIOHandler(new RecordingIOSystem(&opened));
+    }
+
+	const u32 import_flags =
+		aiProcess_CalcTangentSpace |
+		aiProcess_Triangulate |
+		aiProcess_JoinIdenticalVertices |
+		aiProcess_GenNormals |
+		aiProcess_GenUVCoords |
+		aiProcess_SortByPType |
+		aiProcess_OptimizeMeshes |
+		aiProcess_GlobalScale |
+		aiProcess_FlipUVs |
+		aiProcess_ValidateDataStructure;
+
+    const aiScene *scene = importer.ReadFile(path, import_flags);
+
+	if (!scene) {
+		LogError("Failed to load model: %s", importer.GetErrorString());
+		return false;
+	}
+
+    if (dependencies) {
+        for (string &file : opened) {
+            if (file != path) {
+                dependencies->push_back(file);
+            }
+        }
+    }
+
+    if (scene->HasMaterials()) {
+        model->materials.resize(scene->mNumMaterials);
+        model->textures.resize(scene->mNumMaterials);
+
+        for (u64 i = 0; i < scene->mNumMaterials; ++i) {
+            aiMaterial *aiMat = scene->mMaterials[i];
+
+            Material *mat = &model->materials[i];
+            *mat = {};
+
+            aiColor3D ambient, diffuse, specular;
+            if (aiMat->Get(AI_MATKEY_COLOR_AMBIENT, ambient) == AI_SUCCESS) {
+                mat->ambient = glm::vec4(ambient.r, ambient.g, ambient.b, 1.0f);
+            }
+            if (aiMat->Get(AI_MATKEY_COLOR_DIFFUSE, diffuse) == AI_SUCCESS) {
+                mat->diffuse = glm::vec4(diffuse.r, diffuse.g, diffuse.b, 1.0f);
+            }
+            if (aiMat->Get(AI_MATKEY_COLOR_SPECULAR, specular) == AI_SUCCESS) {
+                mat->specular = glm::vec4(specular.r, specular.g, specular.b, 1.0f);
+            }
+
+            // Embedded textures are named "*index", those aren't supported
+            aiString texture;
+            if (aiMat->GetTexture(aiTextureType_DIFFUSE, 0, &texture) == AI_SUCCESS && texture.C_Str()[0] != '*') {
+                model->textures[i] = texture.C_Str();
+            }
+        }
+    }
+
+    model->meshes.resize(scene->mNumMeshes);
+	for (u32 i = 0; i < scene->mNumMeshes; ++i) {
+		aiMesh *ai_mesh = scene->mMeshes[i];
+		CookedMesh *mesh = &model->meshes[i];
+
+		mesh->material_index = ai_mesh->mMaterialIndex;
+		mesh->positions.resize(ai_mesh->mNumVertices);
+		mesh->attributes.resize(ai_mesh->mNumVertices);
+		mesh->indices.resize(ai_mesh->mNumFaces * 3);
+
+		aiVector3D zero_vector(0.0f);
+		for (u32 j = 0; j < ai_mesh->mNumVertices; ++j) {
+			aiVector3D pos = ai_mesh->mVertices[j];
+			aiVector3D tex_coords = ai_mesh->HasTextureCoords(0) ? ai_mesh->mTextureCoords[0][j] : zero_vector;
+			aiVector3D normal = ai_mesh->mNormals[j];
+
+            mesh->positions[j] = { pos.x, pos.y, pos.z };
+
+            VertexAttributes *vertex = &mesh->attributes[j];
+            vertex->normal = glm::vec<4, u8>(
+                normal.x * 127.0f + 127.0f,
+                normal.y * 127.0f + 127.0f,
+                normal.z * 127.0f + 127.0f,
+                1
+            );
+            vertex->tex_coord = glm::vec<2, f32>(tex_coords.x, tex_coords.y);
+        }
+
+		for (u32 j = 0; j < ai_mesh->mNumFaces; ++j) {
+			aiFace face = ai_mesh->mFaces[j];
+			mesh->indices[j * 3 + 0] = face.mIndices[0];
+			mesh->indices[j * 3 + 1] = face.mIndices[1];
+			mesh->indices[j * 3 + 2] = face.mIndices[2];
+		}
+	}
+
+    return true;
+}
+
+bool LoadCookedModel(const char *path, CookedModel *model) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+
+    bool ok = true;
+
+    CookedModelHeader header;
+    ok = ok && fread(&header, sizeof(header), 1, file) == 1;
+    ok = ok && header.magic == COOKED_MODEL_MAGIC && header.version == COOKED_MODEL_VERSION;
+
+    if (ok) {
+        model->materials.resize(header.material_count);
+        model->meshes.resize(header.mesh_count);
+
+        ok = fread(model->materials.data(), sizeof(Material), header.material_count, file) == header.material_count;
+    }
+
+    if (ok) {
+        model->textures.resize(header.material_count);
+    }
+
+    for (u32 i = 0; ok && i < header.material_count; ++i) {
+        u32 length;
+        ok = fread(&length, sizeof(length), 1, file) == 1;
+        if (!ok) break;
+
+        model->textures[i].resize(length);
+        ok = fread(model->textures[i].data(), 1, length, file) == length;
+    }
+
+    for (u32 i = 0; ok && i < header.mesh_count; ++i) {
+        CookedMesh *mesh = &model->meshes[i];
+
+        CookedMeshHeader mesh_header;
+        ok = fread(&mesh_header, sizeof(mesh_header), 1, file) == 1;
+        if (!ok) break;
+
+        mesh->material_index = mesh_header.material_index;
+        mesh->positions.resize(mesh_header.vertex_count);
+        mesh->attributes.resize(mesh_header.vertex_count);
+        mesh->indices.resize(mesh_header.index_count);
+
+        ok = ok && fread(mesh->positions.data(), sizeof(VertexPosition), mesh_header.vertex_count, file) == mesh_header.vertex_count;
+        ok = ok && fread(mesh->attributes.data(), sizeof(VertexAttributes), mesh_header.vertex_count, file) == mesh_header.vertex_count;
+        ok = ok && fread(mesh->indices.data(), sizeof(u32), mesh_header.index_count, file) == mesh_header.index_count;
+    }
+
+    fclose(file);
+
+    if (!ok) {
+        LogError("Invalid cooked model file '%s'", path);
+    }
+
+    return ok;
+}
+
+bool SaveCookedModel(const char *path, CookedModel *model) {
+    FILE *file = fopen(path, "wb");
+    if (!file) return false;
+
+    CookedModelHeader header;
+    header.magic = COOKED_MODEL_MAGIC;
+    header.version = COOKED_MODEL_VERSION;
+    header.material_count = u32(model->materials.size());
+    header.mesh_count = u32(model->meshes.size());
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(model->materials.data(), sizeof(Material), model->materials.size(), file);
+
+    // Every material gets a length prefixed path, empty when it has no texture
+    for (u64 i = 0; i < model->materials.size(); ++i) {
+        const char *texture = i < model->textures.size() ? model->textures[i].c_str() : "";
+        u32 length = u32(strlen(texture));
+
+        fwrite(&length, sizeof(length), 1, file);
+        fwrite(texture, 1, length, file);
+    }
+
+    for (CookedMesh &mesh : model->meshes) {
+        CookedMeshHeader mesh_header;
+        mesh_header.material_index = mesh.material_index;
+        mesh_header.vertex_count = u32(mesh.positions.size());
+        mesh_header.index_count = u32(mesh.indices.size());
+
+        fwrite(&mesh_header, sizeof(mesh_header), 1, file);
+        fwrite(mesh.positions.data(), sizeof(VertexPosition), mesh.positions.size(), file);
+        fwrite(mesh.attributes.data(), sizeof(VertexAttributes), mesh.attributes.size(), file);
+        fwrite(mesh.indices.data(), sizeof(u32), mesh.indices.size(), file);
+    }
+
+    bool ok = ferror(file) == 0;
+    fclose(file);
+
+    return ok;
+}
@@ -0,0 +1,54 @@
+#ifndef MODEL_DATA_H
+#define MODEL_DATA_H
+
+#include "Common.h"
+
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+// CPU side model data shared by the runtime importer and the AssetCooker.
+// Nothing in here may depend on Vulkan so the cooker can link it standalone.
+
+// Vertices are split into two streams. Depth-only passes read just the tightly
+// packed positions, the attributes are only fetched by the shading passes.
+struct VertexPosition {
+    f32 x, y, z;
+};
+
+struct VertexAttributes {
+    glm::vec<4, u8> normal;
+    glm::vec<2, f32> tex_coord;
+};
+
+struct alignas(16) Material {
+    glm::vec4 ambient;
+    glm::vec4 diffuse;
+    glm::vec4 specular;
+    f32 shininess;
+    glm::vec3 _padding;
+};
+
+struct CookedMesh {
+    u32 material_index = 0;
+    array<VertexPosition> positions;
+    array<VertexAttributes> attributes;
+    array<u32> indices;
+};
+
+struct CookedModel {
+    array<Material> materials;
+    // Diffuse texture of every material, empty if it has none.
+    // Relative to the model file, ModelImporter resolves them when it loads one.
+    array<string> textures;
+    array<CookedMesh> meshes;
+};
+
+// Bump when the layout of the cooked model file changes
+#define COOKED_MODEL_VERSION 3
+
+// Files the importer read besides path, like the .mtl of an .obj, are added to dependencies
+bool ImportModel(const char *path, CookedModel *model, array<string> *dependencies=0);
+bool LoadCookedModel(const char *path, CookedModel *model);
+bool SaveCookedModel(const char *path, CookedModel *model);
+
+#endif
@@ -0,0 +1,89 @@
+#include "ResidencyManager.h"
+
+#include <algorithm>
+
+ResidencyManager::ResidencyManager(RenderPass *render_pass, u64 budget) : render_pass(render_pass), budget(budget) {
+}
+
+void ResidencyManager::Add(Model *model) {
+    models.push_back(model);
+    model->last_used_frame = frame;
+
+    if (model->resident) {
+        resident_bytes += model->gpu_bytes;
+    }
+}
+
+void ResidencyManager::Remove(Model *model) {
+    auto it = std::find(models.begin(), models.end(), model);
+    if (it == models.end()) {
+        return;
+    }
+
+    if (model->resident) {
+        resident_bytes -= model->gpu_bytes;
+    }
+
+    models.erase(it);
+}
+
+void ResidencyManager::Use(Model *model) {
+    model->last_used_frame = frame;
+
+    if (model->resident) {
+        return;
+    }
+
+    PROFILE_SCOPE("Reload model");
+
+    // Waits for the upload, the frame is recorded but not submitted yet
+    if (ModelImporter::Reload(model, render_pass->graphics_command_pool.handle)) {
+        resident_bytes += model->gpu_bytes;
+        reloads++;
+
+        LogDev("Reloaded %s, %.1fMB resident", model->path.c_str(), f64(resident_bytes) / (1024.0 * 1024.0));
+    }
+}
+
+void ResidencyManager::Update() {
+    PROFILE_FUNCTION();
+
+    frame++;
+
+    if (resident_bytes <= budget) {
+        return;
+    }
+
+    // Buffers of evicted models are only released, so frames in flight can still draw them. The models
+    // drawn last frame are the working set and are likely drawn again right away. When they alone
+    // exceed the budget it's overshot rather than reloading them with a stall every frame.
+    array<Model *> candidates;
+    for (Model *model : models) {
+        bool reloadable = model->cpu_copy || !model->path.empty();
+        bool recently_used = model->last_used_frame + 1 >= frame;
+
+        if (model->resident && reloadable && !recently_used) {
+            candidates.push_back(model);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](Model *a, Model *b) {
+        return a->last_used_frame < b->last_used_frame;
+    });
+
+    for (Model *model : candidates) {
+        if (resident_bytes <= budget) {
+            break;
+        }
+
+        Evict(model);
+    }
+}
+
+void ResidencyManager::Evict(Model *model) {
+    resident_bytes -= model->gpu_bytes;
+    model->Unload();
+    evictions++;
+
+    LogDev("Evicted %s, %.1fMB resident", model->path.c_str(), f64(resident_bytes) / (1024.0 * 1024.0));
+}
@@ -0,0 +1,36 @@
+#ifndef RESIDENCY_MANAGER_H
+#define RESIDENCY_MANAGER_H
+
+#include "Graphics/Model.h"
+
+// Keeps the geometry of the added models within a GPU memory budget. Models are marked as used
+// when they are drawn, and while the budget is exceeded the ones unused for the longest time lose
+// their buffers. Drawing an evicted model uploads it again before it is recorded, from its CPU copy
+// if it kept one, otherwise from its cooked file. Models with neither are never evicted.
+// Material textures aren't counted here. The TextureStreamer keeps them under --texture-budget by dropping
+// the detailed mip levels of the least recently requested ones, and evicting a model leaves its textures loaded.
+struct ResidencyManager {
+    RenderPass *render_pass;
+    array<Model *> models;
+
+    u64 budget;
+    u64 resident_bytes = 0;
+    u64 frame = 0;
+    u32 evictions = 0;
+    u32 reloads = 0;
+
+    ResidencyManager(RenderPass *render_pass, u64 budget);
+
+    void Add(Model *model);
+    void Remove(Model *model);
+
+    // Reloads the model if it was evicted, call before drawing it
+    void Use(Model *model);
+
+    // Call once per frame after MasterRenderer::Begin, before anything is drawn. Models drawn in the
+    // previous frame are never evicted, even when that leaves the budget exceeded.
+    void Update();
+    void Evict(Model *model);
+};
+
+#endif
@@ -1,75 +1,364 @@
 #include "SceneRenderer.h"
 
+#include <math.h>
+
+static void SpecializeClusters(PipelineState *state) {
+    state->Specialize(CLUSTER_CONSTANT_X, CLUSTER_X);
+    state->Specialize(CLUSTER_CONSTANT_Y, CLUSTER_Y);
+    state->Specialize(CLUSTER_CONSTANT_Z, CLUSTER_Z);
+    state->Specialize(CLUSTER_CONSTANT_MAX_LIGHTS, CLUSTER_MAX_LIGHTS);
+}
+
 SceneRenderer::SceneRenderer(VulkanSwapchain *swapchain, RenderPass *render_pass) : render_pass(render_pass) {
-    Shader vertex_shader, fragment_shader;
     vertex_shader.Create("Renderer/Assets/Shaders/lowpoly.vert.spv");
     fragment_shader.Create("Renderer/Assets/Shaders/lowpoly.frag.spv");
 
     PipelineInfo pipeline_info;
     pipeline_info.AddShader(VK_SHADER_STAGE_VERTEX_BIT, &vertex_shader);
     pipeline_info.AddShader(VK_SHADER_STAGE_FRAGMENT_BIT, &fragment_shader);
+	pipeline_info.AddBinding(VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 	pipeline_info.AddBinding(VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 	pipeline_info.AddBinding(VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	pipeline_info.AddBinding(VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	pipeline_info.AddBinding(VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	pipeline_info.AddBinding(VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	pipeline_info.AddBinding(VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+	pipeline_info.AddBinding(VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 	pipeline_info.AddBinding(VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	pipeline_info.AddBinding(VK_SHADER_STAGE_FRAGMENT_BIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
     pipeline_info.AddPushConstant(VK_SHADER_STAGE_VERTEX_BIT, sizeof(MeshData));
+    // All scene materials are opaque
+    pipeline_info.state.blend_enable = VK_FALSE;
+    SpecializeClusters(&pipeline_info.state);
 
     pipeline.Create(swapchain, &pipeline_info);
 
+    descriptor_update_template = CreateDescriptorUpdateTemplate(&pipeline, &pipeline_info, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+    depth_shader.Create("Renderer/Assets/Shaders/depth.vert.spv");
+
+    // Runs inside the main pass, so it keeps the color attachment but never writes it
+    PipelineInfo depth_pipeline_info;
+    depth_pipeline_info.AddShader(VK_SHADER_STAGE_VERTEX_BIT, &depth_shader);
+    depth_pipeline_info.AddBinding(VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    depth_pipeline_info.AddBinding(VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    depth_pipeline_info.AddBinding(VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    depth_pipeline_info.AddPushConstant(VK_SHADER_STAGE_VERTEX_BIT, sizeof(MeshData));
+    depth_pipeline_info.state.blend_enable = VK_FALSE;
+    depth_pipeline_info.state.color_write = VK_FALSE;
+
+    depth_pipeline.Create(swapchain, &depth_pipeline_info);
+
+    depth_descriptor_update_template = CreateDescriptorUpdateTemplate(&depth_pipeline, &depth_pipeline_info, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+    cull_shader.Create("Renderer/Assets/Shaders/cluster_cull.comp.spv");
+
+    PipelineInfo cull_pipeline_info;
+    cull_pipeline_info.AddShader(VK_SHADER_STAGE_COMPUTE_BIT, &cull_shader);
+    cull_pipeline_info.AddBinding(VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    cull_pipeline_info.AddBinding(VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    cull_pipeline_info.AddBinding(VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    SpecializeClusters(&cull_pipeline_info.state);
+
+    cull_pipeline.CreateCompute(&cull_pipeline_info);
+
+    cull_descriptor_update_template = CreateDescriptorUpdateTemplate(&cull_pipeline, &cull_pipeline_info, VK_PIPELINE_BIND_POINT_COMPUTE);
+
+    scene_data = {};
     scene_data_buffer.Create(sizeof(SceneData));
+    cluster_buffer.Create(CLUSTER_COUNT * (CLUSTER_MAX_LIGHTS + 1) * sizeof(u32));
 
-    vertex_shader.Destroy();
-    fragment_shader.Destroy();
+    draw_capacity = 256;
+    draw_data_buffer.Create(draw_capacity * sizeof(DrawData));
 
-    descriptor_update_template = CreateDescriptorUpdateTemplate(&pipeline, &pipeline_info, VK_PIPELINE_BIND_POINT_GRAPHICS);
+    SetLights(0, 0);
+
+    const u8 white[4] = { 255, 255, 255, 255 };
+    default_texture.Create(white, 1, 1, render_pass->graphics_command_pool.handle);
+
+    shadow_renderer = new ShadowRenderer(swapchain);
 }
 
 SceneRenderer::~SceneRenderer() {
-    vkDestroyDescriptorUpdateTemplate(VulkanDevice::handle, descriptor_update_template, 0);
+    VkDevice device = VulkanDevice::handle;
+
+    delete shadow_renderer;
+
+    vkDestroyDescriptorUpdateTemplate(device, descriptor_update_template, 0);
+    vkDestroyDescriptorUpdateTemplate(device, depth_descriptor_update_template, 0);
+    vkDestroyDescriptorUpdateTemplate(device, cull_descriptor_update_template, 0);
 
     scene_data_buffer.Destroy();
+    light_buffer.Destroy();
+    cluster_buffer.Destroy();
+    draw_data_buffer.Destroy();
+    default_texture.Destroy();
+
     pipeline.Destroy();
+    depth_pipeline.Destroy();
+    cull_pipeline.Destroy();
+
+    vertex_shader.Destroy();
+    fragment_shader.Destroy();
+    depth_shader.Destroy();
+    cull_shader.Destroy();
+}
+
+void SceneRenderer::CullLights() {
+    GPU_SCOPE(cmd_buf, "Light culling");
+
+    // The previous frame may still be reading the clusters
+    VkMemoryBarrier before = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &before, 0, 0, 0, 0);
+
+    vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, cull_pipeline.handle);
+
+    DescriptorInfo updates[3] = {
+        &scene_data_buffer,
+        &light_buffer,
+        &cluster_buffer
+    };
+
+    vkCmdPushDescriptorSetWithTemplateFunc(cmd_buf, cull_descriptor_update_template, cull_pipeline.layout, 0, updates);
+
+    vkCmdDispatch(cmd_buf, (CLUSTER_COUNT + 63) / 64, 1, 1);
+
+    VkMemoryBarrier after = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    after.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    after.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &after, 0, 0, 0, 0);
 }
 
 void SceneRenderer::Begin(VkCommandBuffer cmd_buf) {
     this->cmd_buf = cmd_buf;
+    draws.clear();
+}
+
+void SceneRenderer::Prepare() {
+    PROFILE_FUNCTION();
 
-    vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.handle);
+    UploadFrameData();
+    RequestTextures();
+    CullLights();
+    shadow_renderer->Render(cmd_buf, &scene_data, draws);
+}
+
+void SceneRenderer::UploadFrameData() {
+    VkExtent2D extent = render_pass->render_extent;
+    scene_data.screen_size = glm::vec2(f32(extent.width), f32(extent.height));
+    scene_data.view_projection = scene_data.projection * scene_data.view;
+    scene_data.previous_view_projection = has_previous_frame ? previous_view_projection : scene_data.view_projection;
+
+    previous_view_projection = scene_data.view_projection;
+    has_previous_frame = true;
+
+    // Only the rendered projection is jittered, culling and shadows keep the stable one
+    SceneData frame_data = scene_data;
+    frame_data.projection[2][0] += render_pass->jitter.x;
+    frame_data.projection[2][1] += render_pass->jitter.y;
+
+    draw_data.resize(draws.size());
+    for (u64 i = 0; i < draws.size(); ++i) {
+        bool matched = i < previous_draws.size() && previous_draws[i].model == draws[i].model;
+
+        draw_data[i].model_matrix = draws[i].transformation;
+        draw_data[i].previous_model_matrix = matched ? previous_draws[i].transformation : draws[i].transformation;
+    }
+    previous_draws = draws;
+
+    if (draws.size() > draw_capacity) {
+        draw_data_buffer.Release();
+
+        draw_capacity = u32(draws.size()) * 2;
+        draw_data_buffer.Create(draw_capacity * sizeof(DrawData));
+    }
+
+    VkPipelineStageFlags shader_stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+
+    // The previous frame may still be reading both buffers
+    VkMemoryBarrier before = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    before.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd_buf, shader_stages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &before, 0, 0, 0, 0);
+
+    vkCmdUpdateBuffer(cmd_buf, scene_data_buffer.buffer, 0, sizeof(SceneData), &frame_data);
+
+    // vkCmdUpdateBuffer takes at most 64KiB at once
+    VkDeviceSize draw_data_size = draw_data.size() * sizeof(DrawData);
+    for (VkDeviceSize offset = 0; offset < draw_data_size; offset += 65536) {
+        VkDeviceSize size = draw_data_size - offset < 65536 ? draw_data_size - offset : 65536;
+        vkCmdUpdateBuffer(cmd_buf, draw_data_buffer.buffer, offset, size, (u8 *)draw_data.data() + offset);
+    }
+
+    VkMemoryBarrier after = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    after.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    after.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+    vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, shader_stages, 0, 1, &after, 0, 0, 0, 0);
+}
+
+void SceneRenderer::RequestTextures() {
+    if (!streamer) {
+        return;
+    }
+
+    glm::vec3 camera_position = glm::vec3(glm::inverse(scene_data.view)[3]);
+    f32 fov_y = 2.0f * atanf(1.0f / fabsf(scene_data.projection[1][1]));
+    f32 screen_height = f32(render_pass->render_extent.height);
+
+    for (DrawCommand &draw : draws) {
+        Model *model = draw.model;
+        glm::mat4 &transformation = draw.transformation;
+
+        f32 scale = glm::max(glm::length(glm::vec3(transformation[0])), glm::length(glm::vec3(transformation[1])));
+        scale = glm::max(scale, glm::length(glm::vec3(transformation[2])));
+
+        glm::vec3 center = glm::vec3(transformation * glm::vec4(model->bounds_center, 1.0f));
+        f32 radius = model->bounds_radius * scale;
+
+        // Closest the bounds get to the camera, the textures are assumed to span the whole model
+        f32 distance = glm::max(glm::length(center - camera_position) - radius, 0.0f);
+
+        for (Mesh *mesh : model->meshes) {
+            if (mesh->texture) {
+                streamer->Request(mesh->texture, streamer->CalculateMip(mesh->texture, distance, 2.0f * radius, fov_y, screen_height));
+            }
+        }
+    }
 }
 
 void SceneRenderer::End() {
+    GPU_SCOPE(cmd_buf, "Scene");
+
+    PipelineState state = pipeline.state;
+    state.Specialize(LOWPOLY_CONSTANT_DIR_LIGHT, dir_light_enabled);
+    state.Specialize(LOWPOLY_CONSTANT_DEBUG_MODE, u32(debug_mode));
+
+    DynamicState dynamic_state;
+
+    if (wireframe && VulkanPhysicalDevice::features.fillModeNonSolid) {
+        state.polygon_mode = VK_POLYGON_MODE_LINE;
+        dynamic_state.cull_mode = VK_CULL_MODE_NONE;
+    } else if (depth_prepass) {
+        RenderDepthPrepass();
+
+        // Only the closest fragment of every pixel passes
+        dynamic_state.depth_write = VK_FALSE;
+        dynamic_state.depth_compare = VK_COMPARE_OP_EQUAL;
+    }
+
+    // After the pre-pass, which has its own statistics
+    GPU_STATS(cmd_buf, "Scene");
+
+    vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.Get(&state));
+    dynamic_state.Set(cmd_buf);
+
+    for (u64 i = 0; i < draws.size(); ++i) {
+        RenderDraw(&draws[i], u32(i));
+    }
+}
+
+void SceneRenderer::RenderDepthPrepass() {
+    GPU_SCOPE(cmd_buf, "Depth pre-pass");
+    GPU_STATS(cmd_buf, "Depth pre-pass");
+
+    vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, depth_pipeline.handle);
+
+    DynamicState dynamic_state;
+    dynamic_state.Set(cmd_buf);
+
+    for (u64 i = 0; i < draws.size(); ++i) {
+        MeshData mesh_data;
+        mesh_data.draw_index = u32(i);
+        mesh_data.material_index = 0;
+
+        vkCmdPushConstants(cmd_buf, depth_pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MeshData), &mesh_data);
+
+        for (Mesh *mesh : draws[i].model->meshes) {
+            DescriptorInfo updates[3] = {
+                &scene_data_buffer,
+                mesh->positions_buffer,
+                &draw_data_buffer
+            };
+
+            vkCmdPushDescriptorSetWithTemplateFunc(cmd_buf, depth_descriptor_update_template, depth_pipeline.layout, 0, updates);
+
+            vkCmdBindIndexBuffer(cmd_buf, mesh->index_buffer->buffer, 0, VK_INDEX_TYPE_UINT32);
+
+            RenderStats::DrawCall();
+            RenderStats::CountTriangles(mesh->index_buffer->count / 3);
+            vkCmdDrawIndexed(cmd_buf, mesh->index_buffer->count, 1, 0, 0, 0);
+        }
+    }
 }
 
 void SceneRenderer::SetSceneData(SceneData *scene_data) {
-    u32 size = 3 * sizeof(glm::mat4) + 16 + scene_data->num_point_lights * sizeof(PointLight);
-    
-    scene_data_buffer.SetData(scene_data, size, render_pass->graphics_command_pool.handle);
+    u32 num_point_lights = this->scene_data.num_point_lights;
+    this->scene_data = *scene_data;
+
+    SceneData *data = &this->scene_data;
+
+    // Near and far planes of a zero to one depth perspective matrix
+    data->z_near = data->projection[3][2] / data->projection[2][2];
+    data->z_far = data->projection[3][2] / (data->projection[2][2] + 1.0f);
+    data->inverse_projection = glm::inverse(data->projection);
+    data->num_point_lights = num_point_lights;
+}
+
+void SceneRenderer::SetLights(PointLight *lights, u32 count) {
+    VkCommandPool command_pool = render_pass->graphics_command_pool.handle;
+
+    if (count > light_capacity || light_capacity == 0) {
+        if (light_capacity != 0) {
+            light_buffer.Release();
+        }
+
+        light_capacity = count > 64 ? count : 64;
+        light_buffer.Create(light_capacity * sizeof(PointLight));
+    }
+
+    if (count > 0) {
+        light_buffer.SetData(lights, count * sizeof(PointLight), command_pool);
+    }
+
+    scene_data.num_point_lights = count;
 }
 
 void SceneRenderer::RenderModel(Model *model) {
+    if (residency) {
+        residency->Use(model);
+    }
+
+    draws.push_back({ model, model->transformation });
+}
+
+void SceneRenderer::RenderDraw(DrawCommand *draw, u32 draw_index) {
+    Model *model = draw->model;
+
     for (Mesh *mesh : model->meshes) {
-        DescriptorInfo updates[3] = { 
+        DescriptorInfo updates[10] = {
             &scene_data_buffer,
-            mesh->vertices_buffer,
-            model->materials_buffer
+            mesh->positions_buffer,
+            mesh->attributes_buffer,
+            model->materials_buffer,
+            &light_buffer,
+            &cluster_buffer,
+            DescriptorInfo(shadow_renderer->sampler, shadow_renderer->array_view),
+            &shadow_renderer->shadow_data_buffer,
+            &draw_data_buffer,
+            mesh->texture ? &mesh->texture->image : &default_texture
         };
 
         vkCmdPushDescriptorSetWithTemplateFunc(cmd_buf, descriptor_update_template, pipeline.layout, 0, updates);
 
-        RenderStats::CountTriangles(mesh->vertices_buffer->size / sizeof(Vertex) / 3);
-
         MeshData mesh_data;
+        mesh_data.draw_index = draw_index;
         mesh_data.material_index = mesh->material_index;
-        // TODO: Change
-        mesh_data.model_matrix = model->transformation;
 
-        // TODO: change sometime in future to not use push constants?
-        // The issue is that we would need some dynamic uniforms to update uniform buffers
-        // We can't use dynamic buffers though because of we use push decriptors
         vkCmdPushConstants(cmd_buf, pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(MeshData), &mesh_data);
 
         vkCmdBindIndexBuffer(cmd_buf, mesh->index_buffer->buffer, 0, VK_INDEX_TYPE_UINT32);
 
         RenderStats::DrawCall();
+        RenderStats::CountTriangles(mesh->index_buffer->count / 3);
         vkCmdDrawIndexed(cmd_buf, mesh->index_buffer->count, 1, 0, 0, 0);
     }
 }
@@ -3,31 +3,117 @@
 
 #include "Vulkan/VulkanRenderer.h"
 #include "Graphics/Model.h"
+#include "Graphics/ResidencyManager.h"
+#include "Graphics/ShadowRenderer.h"
+
+// Specialization constant ids of lowpoly.frag, cluster_cull.comp shares the CLUSTER_* ones
+#define LOWPOLY_CONSTANT_DIR_LIGHT          0
+#define LOWPOLY_CONSTANT_DEBUG_MODE         1
+#define CLUSTER_CONSTANT_X                  2
+#define CLUSTER_CONSTANT_Y                  3
+#define CLUSTER_CONSTANT_Z                  4
+#define CLUSTER_CONSTANT_MAX_LIGHTS         5
+
+// Froxel grid over the view frustum, depth slices are spaced exponentially
+#define CLUSTER_X           16
+#define CLUSTER_Y           9
+#define CLUSTER_Z           24
+#define CLUSTER_MAX_LIGHTS  128
+#define CLUSTER_COUNT       (CLUSTER_X * CLUSTER_Y * CLUSTER_Z)
+
+enum class DebugMode : u32 {
+    Lit,
+    Normals,
+    Albedo,
+    LightCount,
+    Count
+};
 
 struct alignas(16) SceneData {
     glm::mat4 projection;
     glm::mat4 view;
     DirectionalLight dir_light;
-    u8 num_point_lights;
-    PointLight point_lights[10];
+
+    // Filled in by SetSceneData
+    glm::mat4 inverse_projection;
+    glm::vec2 screen_size;
+    f32 z_near;
+    f32 z_far;
+    u32 num_point_lights;
+    glm::vec3 _padding;
+
+    // Unjittered, for motion vectors. Filled in every frame by Prepare
+    glm::mat4 view_projection;
+    glm::mat4 previous_view_projection;
 };
 
 struct SceneRenderer {
     RenderPass *render_pass;
+    // Optional, evicted models are reloaded when they are queued
+    ResidencyManager *residency = 0;
+    // Optional, Prepare requests the mip levels the queued models need from it
+    TextureStreamer *streamer = 0;
+    // White, bound for meshes without a diffuse texture
+    Image default_texture;
+    Shader vertex_shader;
+    Shader fragment_shader;
     Pipeline pipeline;
     VkDescriptorUpdateTemplate descriptor_update_template;
 
+    Shader depth_shader;
+    Pipeline depth_pipeline;
+    VkDescriptorUpdateTemplate depth_descriptor_update_template;
+
+    Shader cull_shader;
+    Pipeline cull_pipeline;
+    VkDescriptorUpdateTemplate cull_descriptor_update_template;
+
+    SceneData scene_data;
     StorageBuffer scene_data_buffer;
+    StorageBuffer light_buffer;
+    // Light count followed by CLUSTER_MAX_LIGHTS indices for every cluster
+    StorageBuffer cluster_buffer;
+    u32 light_capacity = 0;
+    StorageBuffer draw_data_buffer;
+    u32 draw_capacity = 0;
+
+    ShadowRenderer *shadow_renderer;
+
     VkCommandBuffer cmd_buf;
+    // Recorded in End, after the shadow maps that need them are done
+    array<DrawCommand> draws;
+    // Draws are matched with the previous frame by order for their previous transformation
+    array<DrawCommand> previous_draws;
+    array<DrawData> draw_data;
+    glm::mat4 previous_view_projection;
+    bool has_previous_frame = false;
+
+    bool wireframe = false;
+    // Lays down depth first so the main pass only shades visible fragments
+    bool depth_prepass = false;
+    bool dir_light_enabled = true;
+    DebugMode debug_mode = DebugMode::Lit;
 
     SceneRenderer(VulkanSwapchain *swapchain, RenderPass *render_pass);
     ~SceneRenderer();
 
     void Begin(VkCommandBuffer cmd_buf);
+    // Light culling and shadow maps for the queued models, has to be recorded before the main pass begins
+    void Prepare();
     void End();
 
+    // Scene data with this frame's jitter and the per draw matrices
+    void UploadFrameData();
+    // Picks the mip level of every drawn texture from the screen size of its model
+    void RequestTextures();
+    void CullLights();
+    void RenderDepthPrepass();
+
     void SetSceneData(SceneData *scene_data);
+    void SetLights(PointLight *lights, u32 count);
+    // Queues the model with its current transformation
     void RenderModel(Model *model);
+    void RenderDraw(DrawCommand *draw, u32 draw_index);
 };
 
 #endif
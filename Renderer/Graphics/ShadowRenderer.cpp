@@ -0,0 +1,314 @@
+#include "ShadowRenderer.h"
+
+#include <math.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Graphics/SceneRenderer.h"
+
+// Blend between logarithmic and uniform cascade splits
+#define SHADOW_SPLIT_LAMBDA 0.75f
+
+// The cascade grows by one snap step on every side, which has to leave room for the slice
+static_assert(SHADOW_SNAP_TEXELS * 2 < SHADOW_MAP_SIZE, "Shadow snap step is too large for the map");
+
+ShadowRenderer::ShadowRenderer(VulkanSwapchain *swapchain) {
+    VkDevice device = VulkanDevice::handle;
+
+    vertex_shader.Create("Renderer/Assets/Shaders/shadow.vert.spv");
+
+    PipelineInfo pipeline_info;
+    pipeline_info.AddShader(VK_SHADER_STAGE_VERTEX_BIT, &vertex_shader);
+    pipeline_info.AddBinding(VK_SHADER_STAGE_VERTEX_BIT, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+    pipeline_info.AddPushConstant(VK_SHADER_STAGE_VERTEX_BIT, sizeof(glm::mat4));
+    pipeline_info.state.depth_only = VK_TRUE;
+    pipeline_info.state.depth_bias = VK_TRUE;
+
+    pipeline.Create(swapchain, &pipeline_info);
+
+    descriptor_update_template = CreateDescriptorUpdateTemplate(&pipeline, &pipeline_info, VK_PIPELINE_BIND_POINT_GRAPHICS);
+
+    VkImageCreateInfo image_info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
+    image_info.imageType = VK_IMAGE_TYPE_2D;
+    image_info.format = VK_FORMAT_D32_SFLOAT;
+    image_info.extent.width = SHADOW_MAP_SIZE;
+    image_info.extent.height = SHADOW_MAP_SIZE;
+    image_info.extent.depth = 1;
+    image_info.mipLevels = 1;
+    image_info.arrayLayers = SHADOW_CASCADES;
+    image_info.samples = VK_SAMPLE_COUNT_1_BIT;
+    image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
+    image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+    image_info.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    allocation = AllocateVulkanImage(image_info, VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::RenderTargets, &image);
+
+    VkImageViewCreateInfo view_info = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
+    view_info.image = image;
+    view_info.viewType = VK_IMAGE_VIEW_TYPE_2D_ARRAY;
+    view_info.format = VK_FORMAT_D32_SFLOAT;
+    view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
+    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.layerCount = SHADOW_CASCADES;
+
+    VK_CHECK(vkCreateImageView(device, &view_info, 0, &array_view));
+
+    for (u32 i = 0; i < SHADOW_CASCADES; ++i) {
+        view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
+        view_info.subresourceRange.baseArrayLayer = i;
+        view_info.subresourceRange.layerCount = 1;
+
+        VK_CHECK(vkCreateImageView(device, &view_info, 0, &cascades[i].view));
+    }
+
+    // Hardware compare with linear filtering gives 2x2 PCF per tap,
+    // everything outside of a cascade counts as lit
+    VkSamplerCreateInfo sampler_info = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_BORDER;
+    sampler_info.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+    sampler_info.compareEnable = VK_TRUE;
+    sampler_info.compareOp = VK_COMPARE_OP_LESS_OR_EQUAL;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    VK_CHECK(vkCreateSampler(device, &sampler_info, 0, &sampler));
+
+    shadow_data = {};
+    shadow_data_buffer.Create(sizeof(ShadowData));
+}
+
+ShadowRenderer::~ShadowRenderer() {
+    VkDevice device = VulkanDevice::handle;
+
+    vkDestroyDescriptorUpdateTemplate(device, descriptor_update_template, 0);
+
+    shadow_data_buffer.Destroy();
+
+    vkDestroySampler(device, sampler, 0);
+    vkDestroyImageView(device, array_view, 0);
+    for (u32 i = 0; i < SHADOW_CASCADES; ++i) {
+        vkDestroyImageView(device, cascades[i].view, 0);
+    }
+    FreeVulkanImage(image, allocation);
+
+    pipeline.Destroy();
+    vertex_shader.Destroy();
+}
+
+static glm::vec4 WorldBounds(DrawCommand *draw) {
+    glm::mat4 &m = draw->transformation;
+
+    glm::vec3 center = glm::vec3(m * glm::vec4(draw->model->bounds_center, 1.0f));
+    f32 scale = glm::max(glm::length(glm::vec3(m[0])), glm::max(glm::length(glm::vec3(m[1])), glm::length(glm::vec3(m[2]))));
+
+    return glm::vec4(center, draw->model->bounds_radius * scale);
+}
+
+void ShadowRenderer::Render(VkCommandBuffer cmd_buf, SceneData *scene_data, array<DrawCommand> &draws) {
+    GPU_SCOPE(cmd_buf, "Shadows");
+    GPU_STATS(cmd_buf, "Shadows");
+
+    rendered_cascades = 0;
+
+    f32 z_near = scene_data->z_near;
+    f32 z_far = glm::min(scene_data->z_far, SHADOW_DISTANCE);
+
+    glm::vec3 light_dir = glm::normalize(scene_data->dir_light.dir);
+    glm::vec3 up = fabsf(light_dir.y) > 0.99f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::mat4 light_rotation = glm::lookAtRH(glm::vec3(0.0f), -light_dir, up);
+    glm::mat4 inverse_light_rotation = glm::inverse(light_rotation);
+
+    // Frustum corners on the near and far plane, slices are interpolated between them
+    glm::mat4 inverse_view_projection = glm::inverse(scene_data->projection * scene_data->view);
+    glm::vec3 near_corners[4];
+    glm::vec3 far_corners[4];
+
+    for (u32 i = 0; i < 4; ++i) {
+        glm::vec2 ndc = glm::vec2((i & 1) ? 1.0f : -1.0f, (i & 2) ? 1.0f : -1.0f);
+
+        glm::vec4 near_corner = inverse_view_projection * glm::vec4(ndc, 0.0f, 1.0f);
+        glm::vec4 far_corner = inverse_view_projection * glm::vec4(ndc, 1.0f, 1.0f);
+
+        near_corners[i] = glm::vec3(near_corner) / near_corner.w;
+        far_corners[i] = glm::vec3(far_corner) / far_corner.w;
+    }
+
+    f32 frustum_depth = scene_data->z_far - scene_data->z_near;
+
+    array<glm::vec4> bounds(draws.size());
+    for (u64 i = 0; i < draws.size(); ++i) {
+        bounds[i] = WorldBounds(&draws[i]);
+    }
+
+    bool changed = false;
+    f32 slice_begin = z_near;
+
+    for (u32 c = 0; c < SHADOW_CASCADES; ++c) {
+        ShadowCascade *cascade = &cascades[c];
+
+        f32 p = f32(c + 1) / f32(SHADOW_CASCADES);
+        f32 log_split = z_near * powf(z_far / z_near, p);
+        f32 uniform_split = z_near + (z_far - z_near) * p;
+        f32 slice_end = SHADOW_SPLIT_LAMBDA * log_split + (1.0f - SHADOW_SPLIT_LAMBDA) * uniform_split;
+
+        // Bounding sphere of the slice, its size doesn't change when the camera rotates
+        glm::vec3 corners[8];
+        glm::vec3 center = glm::vec3(0.0f);
+
+        for (u32 i = 0; i < 4; ++i) {
+            glm::vec3 ray = far_corners[i] - near_corners[i];
+
+            corners[i] = near_corners[i] + ray * ((slice_begin - scene_data->z_near) / frustum_depth);
+            corners[i + 4] = near_corners[i] + ray * ((slice_end - scene_data->z_near) / frustum_depth);
+
+            center += corners[i] + corners[i + 4];
+        }
+        center /= 8.0f;
+
+        f32 radius = 0.0f;
+        for (u32 i = 0; i < 8; ++i) {
+            radius = glm::max(radius, glm::length(corners[i] - center));
+        }
+        radius = ceilf(radius * 16.0f) / 16.0f;
+
+        // Snapping moves the center by up to one snap step per axis, so the cascade is grown by that
+        // first. Its texel size has to be final before snapping, or the step isn't whole texels.
+        radius /= 1.0f - 2.0f * f32(SHADOW_SNAP_TEXELS) / f32(SHADOW_MAP_SIZE);
+
+        f32 texel = 2.0f * radius / f32(SHADOW_MAP_SIZE);
+        f32 snap = texel * f32(SHADOW_SNAP_TEXELS);
+
+        glm::vec3 light_center = glm::vec3(light_rotation * glm::vec4(center, 1.0f));
+        light_center = glm::floor(light_center / snap) * snap;
+        center = glm::vec3(inverse_light_rotation * glm::vec4(light_center, 1.0f));
+
+        f32 depth = 2.0f * radius + SHADOW_CASTER_RANGE;
+        glm::mat4 light_view = glm::lookAtRH(center + light_dir * (radius + SHADOW_CASTER_RANGE), center, up);
+        glm::mat4 light_projection = glm::orthoRH_ZO(-radius, radius, -radius, radius, 0.0f, depth);
+
+        cascade->matrix = light_projection * light_view;
+
+        shadow_data.cascade_matrices[c] = cascade->matrix;
+        shadow_data.cascade_splits[c] = slice_end;
+        shadow_data.cascade_texel_sizes[c] = texel;
+
+        array<DrawCommand *> casters;
+        u64 hash = HashBytes(&cascade->matrix, sizeof(glm::mat4));
+
+        for (u64 i = 0; i < draws.size(); ++i) {
+            glm::vec3 p = glm::vec3(light_view * glm::vec4(glm::vec3(bounds[i]), 1.0f));
+            f32 r = bounds[i].w;
+
+            if (fabsf(p.x) > radius + r || fabsf(p.y) > radius + r || -p.z > depth + r || -p.z < -r) {
+                continue;
+            }
+
+            casters.push_back(&draws[i]);
+            hash = HashBytes(&draws[i].model, sizeof(Model *), hash);
+            hash = HashBytes(&draws[i].transformation, sizeof(glm::mat4), hash);
+        }
+
+        if (!cascade->valid || cascade->content_hash != hash) {
+            RenderCascade(cmd_buf, cascade, c, casters);
+
+            cascade->content_hash = hash;
+            cascade->valid = true;
+            changed = true;
+            rendered_cascades++;
+        }
+
+        slice_begin = slice_end;
+    }
+
+    if (changed) {
+        // The previous frame may still be reading the old matrices
+        VkMemoryBarrier before = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        before.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &before, 0, 0, 0, 0);
+
+        vkCmdUpdateBuffer(cmd_buf, shadow_data_buffer.buffer, 0, sizeof(ShadowData), &shadow_data);
+
+        VkMemoryBarrier after = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+        after.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        after.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+        vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 1, &after, 0, 0, 0, 0);
+    }
+}
+
+void ShadowRenderer::RenderCascade(VkCommandBuffer cmd_buf, ShadowCascade *cascade, u32 layer, array<DrawCommand *> &casters) {
+    VkImageMemoryBarrier begin_barrier = CreateBarrier(
+        image, 0, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
+        cascade->valid ? VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+        VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT
+    );
+    begin_barrier.subresourceRange.baseArrayLayer = layer;
+
+    vkCmdPipelineBarrier(
+        cmd_buf, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+        VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, 0,
+        0, 0, 0, 0, 1, &begin_barrier
+    );
+
+    VkRenderingAttachmentInfo depth_attachment = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
+    depth_attachment.imageView = cascade->view;
+    depth_attachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
+    depth_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    depth_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    depth_attachment.clearValue.depthStencil = { 1.0f, 0 };
+
+    VkRenderingInfo rendering_info = { VK_STRUCTURE_TYPE_RENDERING_INFO };
+    rendering_info.renderArea.extent = { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE };
+    rendering_info.layerCount = 1;
+    rendering_info.pDepthAttachment = &depth_attachment;
+
+    vkCmdBeginRendering(cmd_buf, &rendering_info);
+
+    VkViewport viewport = { 0.0f, 0.0f, f32(SHADOW_MAP_SIZE), f32(SHADOW_MAP_SIZE), 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, { SHADOW_MAP_SIZE, SHADOW_MAP_SIZE } };
+
+    vkCmdSetViewport(cmd_buf, 0, 1, &viewport);
+    vkCmdSetScissor(cmd_buf, 0, 1, &scissor);
+
+    vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline.handle);
+
+    // Thin walls are modelled single sided, so both faces cast
+    DynamicState dynamic_state;
+    dynamic_state.cull_mode = VK_CULL_MODE_NONE;
+    dynamic_state.Set(cmd_buf);
+    vkCmdSetDepthBias(cmd_buf, 1.25f, 0.0f, 1.75f);
+
+    for (DrawCommand *draw : casters) {
+        glm::mat4 light_model_matrix = cascade->matrix * draw->transformation;
+        vkCmdPushConstants(cmd_buf, pipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &light_model_matrix);
+
+        for (Mesh *mesh : draw->model->meshes) {
+            DescriptorInfo updates[1] = {
+                mesh->positions_buffer
+            };
+
+            vkCmdPushDescriptorSetWithTemplateFunc(cmd_buf, descriptor_update_template, pipeline.layout, 0, updates);
+
+            vkCmdBindIndexBuffer(cmd_buf, mesh->index_buffer->buffer, 0, VK_INDEX_TYPE_UINT32);
+
+            RenderStats::DrawCall();
+            RenderStats::CountTriangles(mesh->index_buffer->count / 3);
+            vkCmdDrawIndexed(cmd_buf, mesh->index_buffer->count, 1, 0, 0, 0);
+        }
+    }
+
+    vkCmdEndRendering(cmd_buf);
+
+    VkImageMemoryBarrier end_barrier = CreateBarrier(
+        image, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT
+    );
+    end_barrier.subresourceRange.baseArrayLayer = layer;
+
+    vkCmdPipelineBarrier(
+        cmd_buf, VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0,
+        0, 0, 0, 0, 1, &end_barrier
+    );
+}
@@ -0,0 +1,61 @@
+#ifndef SHADOW_RENDERER_H
+#define SHADOW_RENDERER_H
+
+#include "Vulkan/VulkanRenderer.h"
+#include "Graphics/Model.h"
+
+#define SHADOW_CASCADES     4
+#define SHADOW_MAP_SIZE     2048
+// View depth up to which the directional light casts shadows
+#define SHADOW_DISTANCE     60.0f
+// Casters this far behind a cascade towards the light still land in it
+#define SHADOW_CASTER_RANGE 30.0f
+// Cascade centers snap to multiples of this many texels, so small camera
+// movements leave the cascade matrices and with them the cached maps untouched
+#define SHADOW_SNAP_TEXELS  128
+
+struct SceneData;
+
+struct alignas(16) ShadowData {
+    glm::mat4 cascade_matrices[SHADOW_CASCADES];
+    // View depth at which each cascade ends
+    glm::vec4 cascade_splits;
+    // World size of one shadow map texel, for the normal offset
+    glm::vec4 cascade_texel_sizes;
+};
+
+struct ShadowCascade {
+    VkImageView view;
+    glm::mat4 matrix;
+    // Hash of the matrix and every caster inside, the map is only re-rendered when it changes
+    u64 content_hash = 0;
+    bool valid = false;
+};
+
+// Cascaded shadow maps for the directional light, rendered with a depth-only pipeline
+// that reads nothing but vertex positions
+struct ShadowRenderer {
+    Shader vertex_shader;
+    Pipeline pipeline;
+    VkDescriptorUpdateTemplate descriptor_update_template;
+
+    VkImage image;
+    VmaAllocation allocation;
+    // All cascades as one array, for sampling
+    VkImageView array_view;
+    VkSampler sampler;
+
+    ShadowCascade cascades[SHADOW_CASCADES];
+    ShadowData shadow_data;
+    StorageBuffer shadow_data_buffer;
+    u32 rendered_cascades = 0;
+
+    ShadowRenderer(VulkanSwapchain *swapchain);
+    ~ShadowRenderer();
+
+    // Has to be recorded outside of a render pass
+    void Render(VkCommandBuffer cmd_buf, SceneData *scene_data, array<DrawCommand> &draws);
+    void RenderCascade(VkCommandBuffer cmd_buf, ShadowCascade *cascade, u32 layer, array<DrawCommand *> &casters);
+};
+
+#endif
@@ -0,0 +1,146 @@
+#include "TemporalUpsampler.h"
+
+static f32 Halton(u32 index, u32 base) {
+    f32 result = 0.0f;
+    f32 fraction = 1.0f;
+
+    while (index > 0) {
+        fraction /= f32(base);
+        result += fraction * f32(index % base);
+        index /= base;
+    }
+
+    return result;
+}
+
+TemporalUpsampler::TemporalUpsampler(RenderPass *render_pass) : render_pass(render_pass) {
+    VkDevice device = VulkanDevice::handle;
+
+    shader.Create("Renderer/Assets/Shaders/taa.comp.spv");
+
+    PipelineInfo pipeline_info;
+    pipeline_info.AddShader(VK_SHADER_STAGE_COMPUTE_BIT, &shader);
+    pipeline_info.AddBinding(VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    pipeline_info.AddBinding(VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    pipeline_info.AddBinding(VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+    pipeline_info.AddBinding(VK_SHADER_STAGE_COMPUTE_BIT, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+    pipeline_info.AddPushConstant(VK_SHADER_STAGE_COMPUTE_BIT, sizeof(UpsampleData));
+
+    pipeline.CreateCompute(&pipeline_info);
+
+    descriptor_update_template = CreateDescriptorUpdateTemplate(&pipeline, &pipeline_info, VK_PIPELINE_BIND_POINT_COMPUTE);
+
+    VkSamplerCreateInfo sampler_info = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
+    sampler_info.magFilter = VK_FILTER_LINEAR;
+    sampler_info.minFilter = VK_FILTER_LINEAR;
+    sampler_info.addressModeU = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeV = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.addressModeW = VK_SAMPLER_ADDRESS_MODE_CLAMP_TO_EDGE;
+    sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_NEAREST;
+
+    VK_CHECK(vkCreateSampler(device, &sampler_info, 0, &sampler));
+}
+
+TemporalUpsampler::~TemporalUpsampler() {
+    VkDevice device = VulkanDevice::handle;
+
+    vkDestroyDescriptorUpdateTemplate(device, descriptor_update_template, 0);
+    vkDestroySampler(device, sampler, 0);
+
+    pipeline.Destroy();
+    shader.Destroy();
+}
+
+void TemporalUpsampler::Begin() {
+    if (!enabled) {
+        render_pass->jitter = glm::vec2(0.0f);
+        history_valid = false;
+        return;
+    }
+
+    u32 index = frame % TEMPORAL_JITTER_SAMPLES + 1;
+    frame++;
+
+    // Offset within one pixel of the internal resolution
+    glm::vec2 offset = glm::vec2(Halton(index, 2), Halton(index, 3)) - 0.5f;
+    VkExtent2D extent = render_pass->render_extent;
+
+    render_pass->jitter = offset * 2.0f / glm::vec2(f32(extent.width), f32(extent.height));
+}
+
+Image *TemporalUpsampler::Resolve(VkCommandBuffer cmd_buf, RenderImages *images) {
+    GPU_SCOPE(cmd_buf, "Temporal upsampling");
+
+    Image *output = &images->history_images[history_index];
+    Image *history = &images->history_images[1 - history_index];
+
+    if (history->handle != history_handle) {
+        history_valid = false;
+    }
+
+    VkImageMemoryBarrier barriers[4] = {
+        CreateBarrier(
+            images->color_image.handle, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
+        ),
+        CreateBarrier(
+            images->velocity_image.handle, VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
+        ),
+        CreateBarrier(
+            history->handle, 0, VK_ACCESS_SHADER_READ_BIT,
+            history_valid ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_UNDEFINED,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
+        ),
+        CreateBarrier(
+            output->handle, 0, VK_ACCESS_SHADER_WRITE_BIT,
+            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_ASPECT_COLOR_BIT
+        )
+    };
+
+    // The output was last presented and read as history one and two frames ago
+    vkCmdPipelineBarrier(
+        cmd_buf, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT | VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0,
+        0, 0, 0, 0, ARRAY_SIZE(barriers), barriers
+    );
+
+    vkCmdBindPipeline(cmd_buf, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline.handle);
+
+    DescriptorInfo updates[4] = {
+        DescriptorInfo(sampler, images->color_image.view),
+        DescriptorInfo(sampler, images->velocity_image.view),
+        DescriptorInfo(sampler, history->view),
+        DescriptorInfo(VK_NULL_HANDLE, output->view, VK_IMAGE_LAYOUT_GENERAL)
+    };
+
+    vkCmdPushDescriptorSetWithTemplateFunc(cmd_buf, descriptor_update_template, pipeline.layout, 0, updates);
+
+    VkExtent2D render_extent = render_pass->render_extent;
+
+    UpsampleData data = {};
+    data.jitter = render_pass->jitter * 0.5f;
+    data.render_scale = glm::vec2(f32(render_extent.width) / f32(output->width), f32(render_extent.height) / f32(output->height));
+    data.output_size = glm::vec2(f32(output->width), f32(output->height));
+    data.history_weight = history_valid ? history_weight : 0.0f;
+
+    vkCmdPushConstants(cmd_buf, pipeline.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(UpsampleData), &data);
+
+    vkCmdDispatch(cmd_buf, (output->width + 7) / 8, (output->height + 7) / 8, 1);
+
+    VkImageMemoryBarrier present_barrier = CreateBarrier(
+        output->handle, VK_ACCESS_SHADER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+        VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
+    );
+
+    vkCmdPipelineBarrier(
+        cmd_buf, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+        0, 0, 0, 0, 1, &present_barrier
+    );
+
+    history_index = 1 - history_index;
+    history_handle = output->handle;
+    history_valid = true;
+
+    return output;
+}
@@ -0,0 +1,50 @@
+#ifndef TEMPORAL_UPSAMPLER_H
+#define TEMPORAL_UPSAMPLER_H
+
+#include "Vulkan/VulkanRenderer.h"
+
+// Length of the Halton jitter sequence
+#define TEMPORAL_JITTER_SAMPLES 16
+
+struct alignas(16) UpsampleData {
+    // Jitter of the current frame in uv units
+    glm::vec2 jitter;
+    // Rendered part of the color image in uv units
+    glm::vec2 render_scale;
+    glm::vec2 output_size;
+    // Zero discards the history
+    f32 history_weight;
+    f32 _padding;
+};
+
+// Reconstructs a swapchain sized image from a jittered lower resolution frame.
+// The previous result is reprojected with the velocity target, clamped to the
+// neighborhood of the current frame and blended with it.
+struct TemporalUpsampler {
+    RenderPass *render_pass;
+    Shader shader;
+    Pipeline pipeline;
+    VkDescriptorUpdateTemplate descriptor_update_template;
+    VkSampler sampler;
+
+    bool enabled = false;
+    // Internal resolution while enabled, dynamic resolution works within it
+    f32 max_scale = 0.67f;
+    f32 history_weight = 0.9f;
+
+    u32 frame = 0;
+    u32 history_index = 0;
+    bool history_valid = false;
+    // Last written history image, render images are recreated on resize
+    VkImage history_handle = VK_NULL_HANDLE;
+
+    TemporalUpsampler(RenderPass *render_pass);
+    ~TemporalUpsampler();
+
+    // Picks the jitter of this frame, call after the frame began
+    void Begin();
+    // Has to be called after rendering ended, returns the result in TRANSFER_SRC_OPTIMAL
+    Image *Resolve(VkCommandBuffer cmd_buf, RenderImages *images);
+};
+
+#endif
@@ -0,0 +1,449 @@
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <math.h>
+
+static u32 MipDimension(u32 size, u32 mip) {
+    return size >> mip ? size >> mip : 1;
+}
+
+u64 StreamedTexture::ResidentSize(u32 first_mip) {
+    u64 size = 0;
+    for (u32 i = first_mip; i < level_count; ++i) {
+        size += level_sizes[i];
+    }
+    return size;
+}
+
+TextureStreamer::TextureStreamer(RenderPass *render_pass, u64 budget) : render_pass(render_pass), budget(budget) {
+    command_pool.Create(VulkanDevice::graphics_index);
+
+    worker = std::thread(&TextureStreamer::WorkerLoop, this);
+}
+
+TextureStreamer::~TextureStreamer() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    condition.notify_one();
+    worker.join();
+
+    while (!requests.empty()) {
+        delete requests.front();
+        requests.pop();
+    }
+    for (StreamRequest *request : completed) {
+        delete request;
+    }
+
+    for (StreamTransfer &transfer : transfers) {
+        VK_CHECK(vkWaitForFences(VulkanDevice::handle, 1, &transfer.fence, VK_TRUE, UINT64_MAX));
+        FinishTransfer(&transfer);
+    }
+
+    for (StreamedTexture *texture : textures) {
+        texture->image.Destroy();
+        delete texture;
+    }
+
+    command_pool.Destroy();
+}
+
+StreamedTexture *TextureStreamer::Load(const char *path) {
+    string cooked_path = string(path) + ".ktx2";
+
+    // Materials of different models share their textures
+    for (StreamedTexture *texture : textures) {
+        if (texture->path == cooked_path) {
+            return texture;
+        }
+    }
+
+    KTX2Texture header;
+    bool cooked = IsCookedFileUpToDate(path, cooked_path.c_str());
+    if (cooked) {
+        // Only the index is read here, the levels follow once we know which ones to keep
+        cooked = header.Load(cooked_path.c_str(), 0, 0) && IsTextureFormatSupported(header.format);
+    }
+
+    if (!cooked && !std::filesystem::exists(path)) {
+        LogError("Texture '%s' not found", path);
+        return 0;
+    }
+
+    StreamedTexture *texture = new StreamedTexture();
+    texture->path = cooked_path;
+
+    if (!cooked) {
+        LogDev("Texture '%s' is not cooked, it won't be streamed", path);
+
+        texture->image.Create(path, command_pool.handle);
+        texture->format = texture->image.format;
+        texture->width = texture->image.width;
+        texture->height = texture->image.height;
+        texture->level_count = texture->image.mip_levels;
+        texture->base_mip = 0;
+        texture->resident_mip = 0;
+        texture->requested_mip = 0;
+        texture->streamable = false;
+
+        textures.push_back(texture);
+        return texture;
+    }
+
+    texture->format = header.format;
+    texture->width = header.width;
+    texture->height = header.height;
+    texture->level_count = u32(header.level_sizes.size());
+    texture->level_sizes = header.level_sizes;
+
+    texture->base_mip = 0;
+    while (texture->base_mip + 1 < texture->level_count &&
+           (MipDimension(texture->width, texture->base_mip) > STREAMING_MIN_RESIDENT_SIZE ||
+            MipDimension(texture->height, texture->base_mip) > STREAMING_MIN_RESIDENT_SIZE)) {
+        texture->base_mip++;
+    }
+
+    texture->resident_mip = texture->level_count;
+    texture->requested_mip = texture->base_mip;
+
+    KTX2Texture data;
+    if (!data.Load(texture->path.c_str(), texture->base_mip)) {
+        LogFatal("Failed to load texture '%s'", texture->path.c_str());
+    }
+
+    // The low levels are needed right away, so this is the only transfer we wait for
+    BeginTransfer(texture, texture->base_mip, &data);
+
+    StreamTransfer *transfer = &transfers.back();
+    VK_CHECK(vkWaitForFences(VulkanDevice::handle, 1, &transfer->fence, VK_TRUE, UINT64_MAX));
+    FinishTransfer(transfer);
+    transfers.pop_back();
+
+    textures.push_back(texture);
+    return texture;
+}
+
+u32 TextureStreamer::CalculateMip(StreamedTexture *texture, f32 distance, f32 world_size, f32 fov_y, f32 screen_height) {
+    if (distance < 0.001f) {
+        return 0;
+    }
+
+    f32 pixels_per_unit = screen_height / (2.0f * distance * tanf(fov_y * 0.5f));
+    f32 texels_per_unit = f32(texture->width > texture->height ? texture->width : texture->height) / world_size;
+
+    f32 mip = log2f(texels_per_unit / pixels_per_unit);
+    if (mip <= 0.0f) {
+        return 0;
+    }
+
+    u32 level = u32(mip);
+    return level < texture->level_count ? level : texture->level_count - 1;
+}
+
+void TextureStreamer::Request(StreamedTexture *texture, u32 mip) {
+    if (mip < texture->requested_mip) {
+        texture->requested_mip = mip;
+    }
+    texture->last_requested_frame = frame;
+}
+
+void TextureStreamer::Update() {
+    PROFILE_FUNCTION();
+
+    VkDevice device = VulkanDevice::handle;
+
+    frame++;
+
+    for (u32 i = 0; i < transfers.size();) {
+        if (vkGetFenceStatus(device, transfers[i].fence) == VK_SUCCESS) {
+            FinishTransfer(&transfers[i]);
+            transfers[i] = transfers.back();
+            transfers.pop_back();
+        } else {
+            ++i;
+        }
+    }
+
+    array<StreamRequest *> loaded;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        loaded.swap(completed);
+    }
+
+    for (StreamRequest *request : loaded) {
+        StreamedTexture *texture = request->texture;
+
+        if (request->data.levels.size() == texture->level_count && request->end_mip == texture->resident_mip) {
+            BeginTransfer(texture, request->first_mip, &request->data);
+        } else {
+            LogError("Failed to stream texture '%s'", request->path.c_str());
+            texture->pending = false;
+        }
+
+        delete request;
+    }
+
+    // Figure out what is missing and make room for it before asking the worker
+    u64 missing_bytes = 0;
+    for (StreamedTexture *texture : textures) {
+        if (texture->streamable && !texture->pending && texture->requested_mip < texture->resident_mip) {
+            missing_bytes += texture->ResidentSize(texture->requested_mip) - texture->ResidentSize(texture->resident_mip);
+        }
+    }
+
+    if (resident_bytes + missing_bytes > budget) {
+        Evict(resident_bytes + missing_bytes - budget);
+    }
+
+    u64 scheduled_bytes = 0;
+    for (StreamedTexture *texture : textures) {
+        if (!texture->streamable || texture->pending || texture->requested_mip >= texture->resident_mip) {
+            continue;
+        }
+
+        u64 bytes = texture->ResidentSize(texture->requested_mip) - texture->ResidentSize(texture->resident_mip);
+        if (resident_bytes + scheduled_bytes + bytes > budget) {
+            continue;
+        }
+        scheduled_bytes += bytes;
+
+        StreamRequest *request = new StreamRequest();
+        request->texture = texture;
+        request->path = texture->path;
+        request->first_mip = texture->requested_mip;
+        request->end_mip = texture->resident_mip;
+
+        texture->pending = true;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            requests.push(request);
+        }
+        condition.notify_one();
+    }
+
+    for (StreamedTexture *texture : textures) {
+        texture->requested_mip = texture->base_mip;
+    }
+}
+
+void TextureStreamer::WorkerLoop() {
+    Profiler::SetThreadName("Texture streamer");
+
+    while (true) {
+        StreamRequest *request;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [this] { return !running || !requests.empty(); });
+
+            if (!running) {
+                return;
+            }
+
+            request = requests.front();
+            requests.pop();
+        }
+
+        {
+            PROFILE_SCOPE("Load texture");
+            if (!request->data.Load(request->path.c_str(), request->first_mip, request->end_mip)) {
+                request->data.levels.clear();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        completed.push_back(request);
+    }
+}
+
+// Shrinks textures that are resident in more detail than requested, least recently requested first
+void TextureStreamer::Evict(u64 bytes) {
+    array<StreamedTexture *> candidates;
+    for (StreamedTexture *texture : textures) {
+        if (texture->streamable && !texture->pending && texture->requested_mip > texture->resident_mip) {
+            candidates.push_back(texture);
+        }
+    }
+
+    std::sort(candidates.begin(), candidates.end(), [](StreamedTexture *a, StreamedTexture *b) {
+        return a->last_requested_frame < b->last_requested_frame;
+    });
+
+    u64 freed = 0;
+    for (StreamedTexture *texture : candidates) {
+        if (freed >= bytes) {
+            break;
+        }
+
+        u64 mip_bytes = texture->ResidentSize(texture->resident_mip) - texture->ResidentSize(texture->requested_mip);
+        BeginTransfer(texture, texture->requested_mip, 0);
+
+        // Counted as gone right away so loads scheduled this frame can use the room,
+        // FinishTransfer only accounts for textures that grow
+        resident_bytes -= mip_bytes;
+        freed += mip_bytes;
+    }
+}
+
+// Creates an image holding the levels from first_mip on. Levels that are already resident are
+// copied on the GPU, the others come from data. The old image is swapped out in FinishTransfer.
+void TextureStreamer::BeginTransfer(StreamedTexture *texture, u32 first_mip, KTX2Texture *data) {
+    VkDevice device = VulkanDevice::handle;
+
+    StreamTransfer transfer;
+    transfer.texture = texture;
+    transfer.first_mip = first_mip;
+
+    u32 level_count = texture->level_count - first_mip;
+    VkImageUsageFlags usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+
+    transfer.image.Create(texture->format, MipDimension(texture->width, first_mip), MipDimension(texture->height, first_mip), level_count, VK_SAMPLE_COUNT_1_BIT, usage, MemoryCategory::Textures);
+    transfer.image.CreateSampler();
+
+    VkCommandBufferAllocateInfo allocate_info = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO };
+    allocate_info.commandPool = command_pool.handle;
+    allocate_info.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocate_info.commandBufferCount = 1;
+
+    VK_CHECK(vkAllocateCommandBuffers(device, &allocate_info, &transfer.cmd_buf));
+
+    VkCommandBufferBeginInfo begin_info = { VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO };
+    begin_info.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+    VkCommandBuffer cmd_buf = transfer.cmd_buf;
+    VK_CHECK(vkBeginCommandBuffer(cmd_buf, &begin_info));
+
+    VkImageMemoryBarrier to_transfer = CreateBarrier(
+        transfer.image.handle, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
+    );
+
+    vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &to_transfer);
+
+    // Levels that are not resident yet come from disk
+    u32 upload_end = texture->resident_mip < texture->level_count ? texture->resident_mip : texture->level_count;
+    if (data && first_mip < upload_end) {
+        VkDeviceSize total_size = 0;
+        for (u32 mip = first_mip; mip < upload_end; ++mip) {
+            total_size = (total_size + 15) & ~VkDeviceSize(15);
+            total_size += data->levels[mip].size();
+        }
+
+        VkBufferCreateInfo buffer_info = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+        buffer_info.size = total_size;
+        buffer_info.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        buffer_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+        void *mapped;
+        transfer.staging_allocation = AllocateVulkanBuffer(buffer_info, VMA_MEMORY_USAGE_CPU_ONLY, MemoryCategory::Staging, &transfer.staging_buffer, &mapped);
+
+        array<VkBufferImageCopy> regions;
+
+        VkDeviceSize offset = 0;
+        for (u32 mip = first_mip; mip < upload_end; ++mip) {
+            // Offsets have to be a multiple of the texel block size
+            offset = (offset + 15) & ~VkDeviceSize(15);
+            memcpy((u8 *) mapped + offset, data->levels[mip].data(), data->levels[mip].size());
+
+            VkBufferImageCopy region = {};
+            region.bufferOffset = offset;
+            region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.imageSubresource.mipLevel = mip - first_mip;
+            region.imageSubresource.layerCount = 1;
+            region.imageExtent.width = MipDimension(texture->width, mip);
+            region.imageExtent.height = MipDimension(texture->height, mip);
+            region.imageExtent.depth = 1;
+            regions.push_back(region);
+
+            offset += data->levels[mip].size();
+        }
+
+        vkCmdCopyBufferToImage(cmd_buf, transfer.staging_buffer, transfer.image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, u32(regions.size()), regions.data());
+    }
+
+    // Levels that are already resident are copied over, frames in flight keep sampling the old image
+    u32 copy_begin = first_mip > texture->resident_mip ? first_mip : texture->resident_mip;
+    if (copy_begin < texture->level_count) {
+        VkImage old_image = texture->image.handle;
+        u32 old_base = copy_begin - texture->resident_mip;
+
+        VkImageMemoryBarrier to_src = CreateBarrier(
+            old_image, VK_ACCESS_SHADER_READ_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, old_base
+        );
+
+        vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &to_src);
+
+        array<VkImageCopy> regions;
+        for (u32 mip = copy_begin; mip < texture->level_count; ++mip) {
+            VkImageCopy region = {};
+            region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.srcSubresource.mipLevel = mip - texture->resident_mip;
+            region.srcSubresource.layerCount = 1;
+            region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+            region.dstSubresource.mipLevel = mip - first_mip;
+            region.dstSubresource.layerCount = 1;
+            region.extent.width = MipDimension(texture->width, mip);
+            region.extent.height = MipDimension(texture->height, mip);
+            region.extent.depth = 1;
+            regions.push_back(region);
+        }
+
+        vkCmdCopyImage(cmd_buf, old_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, transfer.image.handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, u32(regions.size()), regions.data());
+
+        VkImageMemoryBarrier to_read = CreateBarrier(
+            old_image, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, old_base
+        );
+
+        vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &to_read);
+    }
+
+    VkImageMemoryBarrier to_read = CreateBarrier(
+        transfer.image.handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
+    );
+
+    vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &to_read);
+
+    VK_CHECK(vkEndCommandBuffer(cmd_buf));
+
+    transfer.fence = CreateFence();
+
+    VkSubmitInfo submit = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submit.commandBufferCount = 1;
+    submit.pCommandBuffers = &cmd_buf;
+
+    VK_CHECK(vkQueueSubmit(VulkanDevice::graphics_queue, 1, &submit, transfer.fence));
+
+    texture->pending = true;
+    transfers.push_back(transfer);
+}
+
+void TextureStreamer::FinishTransfer(StreamTransfer *transfer) {
+    StreamedTexture *texture = transfer->texture;
+
+    // Shrinking transfers were subtracted when Evict started them
+    if (transfer->first_mip < texture->resident_mip) {
+        resident_bytes += texture->ResidentSize(transfer->first_mip) - texture->ResidentSize(texture->resident_mip);
+    }
+
+    // Frames in flight may still read the old image
+    if (texture->image.handle != VK_NULL_HANDLE) {
+        texture->image.Release();
+    }
+
+    texture->image = transfer->image;
+    texture->resident_mip = transfer->first_mip;
+    texture->pending = false;
+
+    if (transfer->staging_buffer != VK_NULL_HANDLE) {
+        FreeVulkanBuffer(transfer->staging_buffer, transfer->staging_allocation);
+    }
+
+    vkFreeCommandBuffers(VulkanDevice::handle, command_pool.handle, 1, &transfer->cmd_buf);
+    DestroyFence(transfer->fence);
+}
@@ -0,0 +1,103 @@
+#ifndef TEXTURE_STREAMER_H
+#define TEXTURE_STREAMER_H
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include "Vulkan/VulkanRenderer.h"
+#include "Core/KTX2.h"
+
+// Levels at or below this size are loaded up front and never evicted
+#define STREAMING_MIN_RESIDENT_SIZE 64
+
+// Mip levels are numbered like in the KTX2 file, 0 is full resolution.
+// image only holds the levels from resident_mip to the smallest one.
+struct StreamedTexture {
+    string path;
+    Image image;
+    VkFormat format;
+    u32 width;
+    u32 height;
+    u32 level_count;
+    array<u64> level_sizes;
+
+    // Most detailed level that stays resident no matter the budget
+    u32 base_mip;
+    u32 resident_mip;
+    // Most detailed level asked for since the last Update
+    u32 requested_mip;
+    u64 last_requested_frame = 0;
+    // A load or copy for this texture is in flight
+    bool pending = false;
+    // Not cooked or not supported by the device, fully resident
+    bool streamable = true;
+
+    u64 ResidentSize(u32 first_mip);
+};
+
+struct StreamRequest {
+    StreamedTexture *texture;
+    string path;
+    u32 first_mip;
+    u32 end_mip;
+    KTX2Texture data;
+};
+
+struct StreamTransfer {
+    StreamedTexture *texture;
+    Image image;
+    u32 first_mip;
+    VkBuffer staging_buffer = VK_NULL_HANDLE;
+    VmaAllocation staging_allocation;
+    VkCommandBuffer cmd_buf;
+    VkFence fence;
+};
+
+// Keeps only the mip levels that are actually needed on the GPU.
+// Callers report the level they need each frame with Request, higher levels are read from
+// disk on a worker thread and uploaded with their own submits so a frame never waits on them.
+// When the budget is exceeded, textures that are resident in more detail than requested
+// are shrunk, least recently requested first.
+struct TextureStreamer {
+    RenderPass *render_pass;
+    VulkanCommandPool command_pool;
+
+    array<StreamedTexture *> textures;
+    array<StreamTransfer> transfers;
+
+    // Only covers the levels of streamable textures. Textures that aren't cooked or whose format the
+    // device doesn't support are fully resident outside of it, LogVulkanMemory still shows them under Textures.
+    u64 budget;
+    u64 resident_bytes = 0;
+    u64 frame = 0;
+
+    std::thread worker;
+    std::mutex mutex;
+    std::condition_variable condition;
+    queue<StreamRequest *> requests;
+    array<StreamRequest *> completed;
+    bool running = true;
+
+    TextureStreamer(RenderPass *render_pass, u64 budget);
+    ~TextureStreamer();
+
+    // Textures loaded before are shared, 0 if neither the file nor its cooked version exists
+    StreamedTexture *Load(const char *path);
+
+    // Distance heuristic: picks the level whose texels are about one pixel on screen
+    // for a surface of world_size units that the whole texture is mapped onto
+    u32 CalculateMip(StreamedTexture *texture, f32 distance, f32 world_size, f32 fov_y, f32 screen_height);
+    void Request(StreamedTexture *texture, u32 mip);
+
+    // Call once per frame after MasterRenderer::Begin, before recording
+    void Update();
+
+    void WorkerLoop();
+    void Evict(u64 bytes);
+
+    void BeginTransfer(StreamedTexture *texture, u32 first_mip, KTX2Texture *data);
+    void FinishTransfer(StreamTransfer *transfer);
+};
+
+#endif
@@ -2,6 +2,8 @@
 
 #include "Core/Camera.h"
 #include "Core/Input.h"
+#include "Core/InputRecorder.h"
+#include "Core/Profiler.h"
 #include "Core/Sound.h"
 #include "Core/Window.h"
 #include "Engine.h"
@@ -9,7 +11,9 @@
 #include "Vulkan/VulkanRenderer.h"
 #include "Graphics/Model.h"
 #include "Graphics/MasterRenderer.h"
+#include "Graphics/ResidencyManager.h"
 #include "Graphics/SceneRenderer.h"
+#include "Graphics/TextureStreamer.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEFAULT_ALIGNED_GENTYPES
@@ -87,31 +91,76 @@ struct Door {
 	}
 };
 
-int main() {
-    Engine engine;
+#define HEADLESS_WIDTH  1280
+#define HEADLESS_HEIGHT 720
+// Images the headless frames rotate through, like a triple buffered swapchain
+#define HEADLESS_IMAGES 3
+
+int main(int argc, char **argv) {
+	Profiler::SetThreadName("Main");
+
+	// --headless renders --frames frames offscreen without a window, surface or swapchain.
+	// --record writes the input of the session to a file, --replay plays it back instead of
+	// live input and writes the time of every frame next to it, to diff between builds.
+	// --model-budget limits the GPU memory of the models in megabytes, least recently drawn ones are evicted.
+	// --texture-budget does the same for the streamed texture levels.
+	bool headless = false;
+	u64 model_budget = 512;
+	u64 texture_budget = 256;
+	u32 headless_frames = 300;
+	const char *record_path = 0;
+	const char *replay_path = 0;
+
+	for (int i = 1; i < argc; ++i) {
+		if (strcmp(argv[i], "--headless") == 0) {
+			headless = true;
+		} else if (strcmp(argv[i], "--frames") == 0 && i + 1 < argc) {
+			headless_frames = u32(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+			record_path = argv[++i];
+		} else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+			replay_path = argv[++i];
+		} else if (strcmp(argv[i], "--model-budget") == 0 && i + 1 < argc) {
+			model_budget = u64(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--texture-budget") == 0 && i + 1 < argc) {
+			texture_budget = u64(atoi(argv[++i]));
+		} else {
+			LogError("Unknown argument %s", argv[i]);
+		}
+	}
+
+    Engine engine(headless);
 
-    engine.window->EnableRawInput();
-	engine.window->SetVSync(true);
+	if (!headless) {
+		engine.window->EnableRawInput();
+		engine.window->SetVSync(true);
+	}
 
     engine.Start();
 
-	InitSound();
+	InitSound(headless);
 
 #ifdef VULKAN_RENDERER_DEBUG
-    VulkanContext context = VulkanContext::Get(true);
+    VulkanContext context = VulkanContext::Get(true, headless);
 #else
-    VulkanContext context = VulkanContext::Get(false);
+    VulkanContext context = VulkanContext::Get(false, headless);
 #endif
 
-    VulkanInstance::Create(&context, engine.window->handle, "Engine");
+    VulkanInstance::Create(&context, headless ? 0 : engine.window->handle, "Engine");
 
     VulkanPhysicalDevice::Pick(&context);
     VulkanDevice::Create(&context);
 
     CreateVulkanAllocator();
+    VulkanPipelineCache::Create("Renderer/Assets/.pipeline_cache");
+    PipelineCompiler::Create();
 
     VulkanSwapchain swapchain;
-    swapchain.Create(true);
+	if (headless) {
+		swapchain.CreateHeadless({ HEADLESS_WIDTH, HEADLESS_HEIGHT }, HEADLESS_IMAGES);
+	} else {
+		swapchain.Create(true);
+	}
 
     RenderPass render_pass;
     render_pass.Create(&swapchain);
@@ -119,6 +168,13 @@ int main() {
     MasterRenderer *master_renderer = new MasterRenderer(&render_pass);
 	SceneRenderer *scene_renderer = new SceneRenderer(&swapchain, &render_pass);
 
+	VulkanPipelineCache::LogStats();
+
+	// Before the models, their material textures are loaded through it
+	TextureStreamer *texture_streamer = new TextureStreamer(&render_pass, texture_budget * 1024 * 1024);
+	ModelImporter::texture_streamer = texture_streamer;
+	scene_renderer->streamer = texture_streamer;
+
 	Model *model_wall_door = ModelImporter::Load("Renderer/Assets/Models/village/Stucco_Doorway_Wide_Tall.obj", render_pass.graphics_command_pool.handle);
 	Model *model_door = ModelImporter::Load("Renderer/Assets/Models/village/Wall_Prop_Door_Ornate.obj", render_pass.graphics_command_pool.handle);
 	Model *model_floor = ModelImporter::Load("Renderer/Assets/Models/village/Stone_Floor_2.obj", render_pass.graphics_command_pool.handle);
@@ -128,10 +184,20 @@ int main() {
 
 	model_well->transformation = glm::translate(glm::mat4(1.0f), glm::vec3(2.0f, 0.0f, 2.0f));
 
+	ResidencyManager residency(&render_pass, model_budget * 1024 * 1024);
+	for (Model *model : { model_wall_door, model_door, model_floor, model_waterwheel, model_well, model_wall_window }) {
+		residency.Add(model);
+	}
+	scene_renderer->residency = &residency;
+
 	SceneData scene_data;
 
 	FreeCamera camera(glm::vec3(0.0));
-	camera.Calculate(engine.window->bounds.width, engine.window->bounds.height);
+	if (headless) {
+		camera.Calculate(HEADLESS_WIDTH, HEADLESS_HEIGHT);
+	} else {
+		camera.Calculate(engine.window->bounds.width, engine.window->bounds.height);
+	}
 
 	DirectionalLight dir_light;
 	dir_light.dir = glm::vec3(0.3f, 1.0f, 0.3f);
@@ -143,9 +209,10 @@ int main() {
 	point_light.pos = glm::vec3(-10.0f, 2.0f, -10.0f);
 	point_light.ambient = glm::vec4(0.2f);
 	point_light.diffuse = glm::vec4(1.0f);
+	point_light.radius = 20.0f;
+
+	scene_renderer->SetLights(&point_light, 1);
 
-	scene_data.point_lights[0] = point_light;
-	scene_data.num_point_lights = 0;
     scene_data.projection = camera.projection;
     scene_data.view = camera.view;
     scene_renderer->SetSceneData(&scene_data);
@@ -154,14 +221,46 @@ int main() {
 	bool show_render_stats = false;
 	bool wireframe = false;
 
-	f64 last_time = glfwGetTime();
+	f64 last_time = GetTime();
 	f32 delta_time = 0.0f;
+	u32 frame_count = 0;
+
+	FILE *replay_timings = 0;
+	if (replay_path) {
+		if (!InputRecorder::StartReplay(replay_path)) {
+			LogFatal("Failed to start the replay");
+		}
+
+		string timings_path = string(replay_path) + ".timings.csv";
+		replay_timings = fopen(timings_path.c_str(), "w");
+		if (replay_timings) {
+			fprintf(replay_timings, "frame,cpu_ms,gpu_ms\n");
+		}
+
+		// Resolution driven by GPU times would make the frames differ between runs
+		master_renderer->dynamic_resolution.enabled = false;
+	} else if (record_path) {
+		InputRecorder::StartRecording(record_path);
+	}
 
 	f64 waterwheel_angle = 0.0f;
 
 	Door door(model_wall_door, model_door);
 
     while (engine.running) {
+		PROFILE_SCOPE("Frame");
+
+		f64 current_time = GetTime();
+		delta_time = f32(current_time - last_time);
+		last_time = current_time;
+
+		// Fixed steps keep headless runs the same from machine to machine
+		if (headless) {
+			delta_time = 1.0f / 60.0f;
+		}
+
+		InputRecorder::Frame(&engine, &delta_time);
+
         while (!engine.events.empty()) {
             Event event = engine.events.front();
             engine.events.pop();
@@ -177,13 +276,52 @@ int main() {
 						if (event.button == (int)KeyCode::E) {
 							door.OpenOrClose();
 						}
-						if (event.button == (int)KeyCode::F11) {
+						if (event.button == (int)KeyCode::F11 && engine.window) {
 							engine.window->ToggleFullscreen();
 						}
+						if (event.button == (int)KeyCode::F2) {
+							wireframe = !wireframe;
+							scene_renderer->wireframe = wireframe;
+						}
+						if (event.button == (int)KeyCode::F5) {
+							u32 mode = (u32(scene_renderer->debug_mode) + 1) % u32(DebugMode::Count);
+							scene_renderer->debug_mode = DebugMode(mode);
+						}
+						if (event.button == (int)KeyCode::F6) {
+							// The GPU time is averaged over the last frames, wait for it to settle before switching back
+							LogInfo("Depth pre-pass %s: %.3fms gpu", scene_renderer->depth_prepass ? "on" : "off", RenderStats::mspf_gpu);
+							scene_renderer->depth_prepass = !scene_renderer->depth_prepass;
+						}
+						if (event.button == (int)KeyCode::F7) {
+							DynamicResolution *dynamic_resolution = &master_renderer->dynamic_resolution;
+							dynamic_resolution->enabled = !dynamic_resolution->enabled;
+							dynamic_resolution->Reset();
+						}
+						if (event.button == (int)KeyCode::F8) {
+							TemporalUpsampler *temporal_upsampler = master_renderer->temporal_upsampler;
+							temporal_upsampler->enabled = !temporal_upsampler->enabled;
+							LogInfo("Temporal upsampling %s", temporal_upsampler->enabled ? "on" : "off");
+						}
 						if (event.button == (int)KeyCode::F3) {
 							show_render_stats = !show_render_stats;
 						}
-						if (event.button == (int)KeyCode::F4) {
+						if (event.button == (int)KeyCode::F10) {
+							Profiler::WriteTrace("cpu_trace.json");
+						}
+						if (event.button == (int)KeyCode::F12) {
+							RenderStats::LogFrameTimes();
+							RenderStats::ExportFrameTimes("frame_times");
+						}
+						if (event.button == (int)KeyCode::F1) {
+							LogVulkanMemory();
+							DumpVulkanMemory("vulkan_memory.json");
+						}
+						if (event.button == (int)KeyCode::F9) {
+							GPUProfiler::Log();
+							GPUPipelineStats::Log();
+							GPUProfiler::Dump("gpu_profile.txt");
+						}
+						if (event.button == (int)KeyCode::F4 && engine.window) {
 							show_editor = !show_editor;
 							if (show_editor) {
 								Input::Lock();
@@ -202,22 +340,32 @@ int main() {
 			engine.running = false;
 		}
 
-		f64 current_time = glfwGetTime();
-		delta_time = f32(current_time - last_time);
-		last_time = current_time;
-
-        bool camera_moved = camera.Update(engine.window, delta_time);
-		Input::Update(engine.window);
-        engine.Update();
-
-        VkCommandBuffer cmd_buf = master_renderer->Begin();
-		scene_renderer->Begin(cmd_buf);
+        bool camera_moved = false;
+		if (!headless || InputRecorder::IsReplaying()) {
+			PROFILE_SCOPE("Camera::Update");
+			camera_moved = camera.Update(engine.window, delta_time);
+		}
+		if (!headless && !InputRecorder::IsReplaying()) {
+			PROFILE_SCOPE("Input::Update");
+			Input::Update(engine.window);
+		}
+		{
+			PROFILE_SCOPE("Engine::Update");
+			engine.Update();
+		}
 
         if (camera_moved) {
             scene_data.projection = camera.projection;
             scene_data.view = camera.view;
 		    scene_renderer->SetSceneData(&scene_data);
         }
+
+        VkCommandBuffer cmd_buf = master_renderer->Begin();
+		residency.Update();
+		texture_streamer->Update();
+
+		PROFILE_SCOPE("Record");
+		scene_renderer->Begin(cmd_buf);
 		scene_renderer->RenderModel(model_well);
 
 		model_waterwheel->transformation = TranslateRotateScale(glm::vec3(2.0f, 1.0f, -2.0f), glm::vec3(waterwheel_angle, 0.0f, 0.0f), glm::vec3(0.5f));
@@ -237,14 +385,43 @@ int main() {
 
         door.Render(scene_renderer, delta_time);
 
+		scene_renderer->Prepare();
+		master_renderer->BeginPass();
 		scene_renderer->End();
         master_renderer->End();
 
-		RenderStats::SetTitle(engine.window->handle);
+		if (!headless) {
+			RenderStats::SetTitle(engine.window->handle, show_render_stats);
+		}
+
+		if (replay_timings) {
+			fprintf(replay_timings, "%u,%.4f,%.4f\n", frame_count, (GetTime() - current_time) * 1000.0, RenderStats::gpu_frame_time);
+		}
+
+		frame_count++;
+		if (InputRecorder::IsReplaying() ? InputRecorder::IsReplayFinished() : headless && frame_count >= headless_frames) {
+			engine.running = false;
+		}
     }
 
+	InputRecorder::Stop();
+
+	RenderStats::LogFrameTimes();
+	RenderStats::ExportFrameTimes("frame_times");
+
+	if (replay_timings) {
+		fclose(replay_timings);
+		LogInfo("Wrote frame timings to %s.timings.csv", replay_path);
+	}
+
     VK_CHECK(vkDeviceWaitIdle(VulkanDevice::handle));
 
+	if (headless) {
+		LogInfo("Rendered %u headless frames, cpu: %.2fms, gpu: %.2fms", frame_count, RenderStats::mspf_cpu, RenderStats::mspf_gpu);
+		GPUProfiler::Log();
+		GPUPipelineStats::Log();
+	}
+
 	delete model_wall_door;
 	delete model_door;
 	delete model_floor;
@@ -253,11 +430,16 @@ int main() {
 	delete model_wall_window;
 	delete scene_renderer;
     delete master_renderer;
+	// Releases the replaced images into the DeletionQueue, so before it is flushed
+	delete texture_streamer;
 
     render_pass.Destroy();
 
     swapchain.Destroy();
 
+    PipelineCompiler::Destroy();
+    VulkanPipelineCache::Destroy();
+    DeletionQueue::Flush();
     DestroyVulkanAllocator();
 
     VulkanDevice::Destroy();
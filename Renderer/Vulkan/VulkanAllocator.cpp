@@ -1,8 +1,48 @@
 #define VMA_IMPLEMENTATION
 #include "VulkanRenderer.h"
 
+#include <atomic>
+#include <mutex>
+
 static VmaAllocator allocator;
 
+// Created on first use for every category and memory type
+static VmaPool pools[u32(MemoryCategory::Count)][VK_MAX_MEMORY_TYPES];
+static std::mutex pools_mutex;
+
+// Buffers defragmentation is allowed to move, with what's needed to recreate them
+struct MovableBuffer {
+    VkBuffer *buffer;
+    VkBufferCreateInfo create_info;
+};
+
+// Only geometry is moved, which is created and destroyed on the main thread
+static map<VmaAllocation, MovableBuffer> movable_buffers;
+
+static VmaDefragmentationContext defragmentation = VK_NULL_HANDLE;
+static u32 frames_since_defrag_check = 0;
+
+// A pass is recorded into one frame and ended once that frame's fence was waited on,
+// until then the old buffers may still be read and their memory can't be reused
+static VmaDefragmentationPassMoveInfo defrag_pass;
+static bool defrag_pass_active = false;
+static u64 defrag_pass_frame = 0;
+static array<VkBuffer> replaced_buffers;
+
+static void EndDefragmentationPass();
+
+// Allocations happen on the streaming thread too
+static std::atomic<u64> category_bytes[u32(MemoryCategory::Count)];
+static std::atomic<u32> category_allocations[u32(MemoryCategory::Count)];
+
+static const char *category_names[u32(MemoryCategory::Count)] = {
+    "Geometry",
+    "Textures",
+    "Render targets",
+    "Staging",
+    "Other"
+};
+
 void CreateVulkanAllocator() {
     VmaAllocatorCreateInfo create_info = {};
     create_info.vulkanApiVersion = VK_API_VERSION_1_3;
@@ -10,19 +50,115 @@ void CreateVulkanAllocator() {
     create_info.physicalDevice = VulkanPhysicalDevice::handle;
     create_info.device = VulkanDevice::handle;
 
+    if (VulkanPhysicalDevice::memory_budget_supported) {
+        create_info.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+    }
+
     vmaCreateAllocator(&create_info, &allocator);
 }
 
 void DestroyVulkanAllocator() {
+    // The device is idle
+    if (defrag_pass_active) {
+        EndDefragmentationPass();
+    }
+
+    if (defragmentation) {
+        vmaEndDefragmentation(allocator, defragmentation, 0);
+        defragmentation = VK_NULL_HANDLE;
+    }
+
+    for (u32 i = 0; i < u32(MemoryCategory::Count); ++i) {
+        for (u32 j = 0; j < VK_MAX_MEMORY_TYPES; ++j) {
+            if (pools[i][j]) {
+                vmaDestroyPool(allocator, pools[i][j]);
+                pools[i][j] = VK_NULL_HANDLE;
+            }
+        }
+    }
+
     vmaDestroyAllocator(allocator);
 }
 
-VmaAllocation AllocateVulkanBuffer(VkBufferCreateInfo buffer_create_info, VmaMemoryUsage usage, VkBuffer *buffer, void **mapped) {
+static VmaPool GetPool(MemoryCategory category, u32 memory_type) {
+    std::lock_guard<std::mutex> lock(pools_mutex);
+
+    VmaPool *pool = &pools[u32(category)][memory_type];
+    if (*pool) {
+        return *pool;
+    }
+
+    VmaPoolCreateInfo pool_info = {};
+    pool_info.memoryTypeIndex = memory_type;
+
+    // Staging memory is freed in about the order it was allocated, a ring buffer in a single block fits that
+    if (category == MemoryCategory::Staging) {
+        pool_info.flags = VMA_POOL_CREATE_LINEAR_ALGORITHM_BIT;
+        pool_info.blockSize = VULKAN_STAGING_POOL_SIZE;
+        pool_info.maxBlockCount = 1;
+    }
+
+    VK_CHECK(vmaCreatePool(allocator, &pool_info, pool));
+    vmaSetPoolName(allocator, *pool, category_names[u32(category)]);
+
+    return *pool;
+}
+
+// The category is stored as the allocation's user data, so freeing doesn't need to be told
+static void TrackAllocation(VmaAllocation allocation, MemoryCategory category) {
+    vmaSetAllocationName(allocator, allocation, category_names[u32(category)]);
+
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+
+    category_bytes[u32(category)] += info.size;
+    category_allocations[u32(category)]++;
+}
+
+static MemoryCategory UntrackAllocation(VmaAllocation allocation) {
+    VmaAllocationInfo info;
+    vmaGetAllocationInfo(allocator, allocation, &info);
+
+    u32 category = u32(uintptr_t(info.pUserData));
+    category_bytes[category] -= info.size;
+    category_allocations[category]--;
+
+    return MemoryCategory(category);
+}
+
+VmaAllocation AllocateVulkanBuffer(VkBufferCreateInfo buffer_create_info, VmaMemoryUsage usage, MemoryCategory category, VkBuffer *buffer, void **mapped) {
     VmaAllocationCreateInfo alloc_create_info = {};
     alloc_create_info.usage = usage;
+    alloc_create_info.pUserData = (void *) uintptr_t(category);
+
+    // Defragmentation copies geometry to its new place
+    if (category == MemoryCategory::Geometry) {
+        buffer_create_info.usage |= VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    }
+
+    u32 memory_type;
+    VK_CHECK(vmaFindMemoryTypeIndexForBufferInfo(allocator, &buffer_create_info, &alloc_create_info, &memory_type));
+    alloc_create_info.pool = GetPool(category, memory_type);
 
     VmaAllocation allocation;
-    vmaCreateBuffer(allocator, &buffer_create_info, &alloc_create_info, buffer, &allocation, 0);
+    VkResult result = vmaCreateBuffer(allocator, &buffer_create_info, &alloc_create_info, buffer, &allocation, 0);
+
+    // Either too large for the ring buffer or it's full
+    if (result != VK_SUCCESS && category == MemoryCategory::Staging) {
+        alloc_create_info.pool = VK_NULL_HANDLE;
+        result = vmaCreateBuffer(allocator, &buffer_create_info, &alloc_create_info, buffer, &allocation, 0);
+    }
+
+    if (result != VK_SUCCESS) {
+        LogVulkanMemory();
+        LogFatal("Failed to allocate a %lu byte buffer for %s (%d)", u64(buffer_create_info.size), category_names[u32(category)], result);
+    }
+
+    TrackAllocation(allocation, category);
+
+    if (category == MemoryCategory::Geometry) {
+        movable_buffers[allocation] = { buffer, buffer_create_info };
+    }
 
     if (mapped) {
         vmaMapMemory(allocator, allocation, mapped);
@@ -31,25 +167,267 @@ VmaAllocation AllocateVulkanBuffer(VkBufferCreateInfo buffer_create_info, VmaMem
     return allocation;
 }
 
+// Allocations that are moved by the active pass can't be freed, VMA frees them when the pass ends
+static bool AbandonMove(VkBuffer buffer, VmaAllocation allocation) {
+    if (!defrag_pass_active) {
+        return false;
+    }
+
+    for (u32 i = 0; i < defrag_pass.moveCount; ++i) {
+        VmaDefragmentationMove *move = &defrag_pass.pMoves[i];
+
+        if (move->srcAllocation == allocation && move->operation == VMA_DEFRAGMENTATION_MOVE_OPERATION_COPY) {
+            vkDestroyBuffer(VulkanDevice::handle, buffer, 0);
+            move->operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_DESTROY;
+            return true;
+        }
+    }
+
+    return false;
+}
+
 void FreeVulkanBuffer(VkBuffer buffer, VmaAllocation allocation) {
     vmaUnmapMemory(allocator, allocation);
-    vmaDestroyBuffer(allocator, buffer, allocation);
+    FreeVulkanBufferNoUnmap(buffer, allocation);
 }
 
 void FreeVulkanBufferNoUnmap(VkBuffer buffer, VmaAllocation allocation) {
+    if (UntrackAllocation(allocation) == MemoryCategory::Geometry) {
+        movable_buffers.erase(allocation);
+
+        if (AbandonMove(buffer, allocation)) {
+            return;
+        }
+    }
     vmaDestroyBuffer(allocator, buffer, allocation);
 }
 
-VmaAllocation AllocateVulkanImage(VkImageCreateInfo image_create_info, VmaMemoryUsage usage, VkImage *image) {
+void PinVulkanBuffer(VmaAllocation allocation) {
+    movable_buffers.erase(allocation);
+}
+
+void InvalidateVulkanBuffer(VmaAllocation allocation) {
+    vmaInvalidateAllocation(allocator, allocation, 0, VK_WHOLE_SIZE);
+}
+
+VmaAllocation AllocateVulkanImage(VkImageCreateInfo image_create_info, VmaMemoryUsage usage, MemoryCategory category, VkImage *image) {
     VmaAllocationCreateInfo alloc_create_info = {};
     alloc_create_info.usage = usage;
+    alloc_create_info.pUserData = (void *) uintptr_t(category);
+
+    u32 memory_type;
+    VK_CHECK(vmaFindMemoryTypeIndexForImageInfo(allocator, &image_create_info, &alloc_create_info, &memory_type));
+    alloc_create_info.pool = GetPool(category, memory_type);
 
     VmaAllocation allocation;
-    vmaCreateImage(allocator, &image_create_info, &alloc_create_info, image, &allocation, 0);
+    VkResult result = vmaCreateImage(allocator, &image_create_info, &alloc_create_info, image, &allocation, 0);
+    if (result != VK_SUCCESS) {
+        LogVulkanMemory();
+        LogFatal(
+            "Failed to allocate a %ux%u image for %s (%d)",
+            image_create_info.extent.width, image_create_info.extent.height, category_names[u32(category)], result
+        );
+    }
+
+    TrackAllocation(allocation, category);
 
     return allocation;
 }
 
 void FreeVulkanImage(VkImage image, VmaAllocation allocation) {
+    UntrackAllocation(allocation);
     vmaDestroyImage(allocator, image, allocation);
-}
\ No newline at end of file
+}
+
+u64 GetVulkanMemoryUsage() {
+    VmaTotalStatistics stats;
+    vmaCalculateStatistics(allocator, &stats);
+
+    return stats.total.statistics.allocationBytes;
+}
+
+u64 GetVulkanMemoryUsage(MemoryCategory category) {
+    return category_bytes[u32(category)];
+}
+
+const char *GetMemoryCategoryName(MemoryCategory category) {
+    return category_names[u32(category)];
+}
+
+void GetVulkanMemoryBudget(u64 *usage, u64 *budget) {
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(allocator, budgets);
+
+    *usage = 0;
+    *budget = 0;
+
+    VkPhysicalDeviceMemoryProperties *properties = &VulkanPhysicalDevice::memory_properties;
+    for (u32 i = 0; i < properties->memoryHeapCount; ++i) {
+        if (properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) {
+            *usage += budgets[i].usage;
+            *budget += budgets[i].budget;
+        }
+    }
+}
+
+void LogVulkanMemory() {
+    VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+    vmaGetHeapBudgets(allocator, budgets);
+
+    VkPhysicalDeviceMemoryProperties *properties = &VulkanPhysicalDevice::memory_properties;
+    for (u32 i = 0; i < properties->memoryHeapCount; ++i) {
+        VmaBudget *heap = &budgets[i];
+        bool device_local = properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+
+        LogInfo(
+            "Heap %u%s: %.1f/%.1fMB used, %.1fMB in %u allocations, %.1fMB in %u blocks",
+            i, device_local ? " (device local)" : "",
+            f64(heap->usage) / (1024.0 * 1024.0), f64(heap->budget) / (1024.0 * 1024.0),
+            f64(heap->statistics.allocationBytes) / (1024.0 * 1024.0), heap->statistics.allocationCount,
+            f64(heap->statistics.blockBytes) / (1024.0 * 1024.0), heap->statistics.blockCount
+        );
+    }
+
+    for (u32 i = 0; i < u32(MemoryCategory::Count); ++i) {
+        LogInfo("%s: %.1fMB in %u allocations", category_names[i], f64(category_bytes[i]) / (1024.0 * 1024.0), u32(category_allocations[i]));
+    }
+
+    // Counted in the categories above until the frames using them are done
+    LogInfo("%u resources waiting for frames in flight", u32(DeletionQueue::pending.size()));
+}
+
+void DumpVulkanMemory(const char *file_path) {
+    FILE *file = fopen(file_path, "w");
+    if (!file) {
+        LogError("Failed to open %s for the memory statistics", file_path);
+        return;
+    }
+
+    char *stats;
+    vmaBuildStatsString(allocator, &stats, VK_TRUE);
+    fputs(stats, file);
+    vmaFreeStatsString(allocator, stats);
+
+    fclose(file);
+    LogInfo("Wrote memory statistics to %s", file_path);
+}
+
+static void BeginDefragmentation() {
+    VkPhysicalDeviceMemoryProperties *properties = &VulkanPhysicalDevice::memory_properties;
+
+    for (u32 i = 0; i < properties->memoryTypeCount; ++i) {
+        VmaPool pool = pools[u32(MemoryCategory::Geometry)][i];
+        if (!pool) {
+            continue;
+        }
+
+        VmaDetailedStatistics stats;
+        vmaCalculatePoolStatistics(allocator, pool, &stats);
+
+        // A single free range at the end is no fragmentation
+        u64 unused = stats.statistics.blockBytes - stats.statistics.allocationBytes;
+        if (stats.unusedRangeCount < 2 || unused * 100 < stats.statistics.blockBytes * VULKAN_DEFRAG_THRESHOLD) {
+            continue;
+        }
+
+        VmaDefragmentationInfo info = {};
+        info.flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_BALANCED_BIT;
+        info.pool = pool;
+        info.maxBytesPerPass = VULKAN_DEFRAG_MAX_BYTES;
+        info.maxAllocationsPerPass = VULKAN_DEFRAG_MAX_MOVES;
+
+        VK_CHECK(vmaBeginDefragmentation(allocator, &info, &defragmentation));
+
+        LogInfo("Defragmenting geometry, %.1fMB unused in %u ranges", f64(unused) / (1024.0 * 1024.0), stats.unusedRangeCount);
+        return;
+    }
+}
+
+static void EndDefragmentation() {
+    VmaDefragmentationStats stats;
+    vmaEndDefragmentation(allocator, defragmentation, &stats);
+    defragmentation = VK_NULL_HANDLE;
+
+    LogInfo(
+        "Defragmented geometry, moved %.1fMB in %u allocations, freed %.1fMB",
+        f64(stats.bytesMoved) / (1024.0 * 1024.0), stats.allocationsMoved, f64(stats.bytesFreed) / (1024.0 * 1024.0)
+    );
+}
+
+// Ends the active pass, the frame that recorded its copies is done
+static void EndDefragmentationPass() {
+    for (VkBuffer buffer : replaced_buffers) {
+        vkDestroyBuffer(VulkanDevice::handle, buffer, 0);
+    }
+    replaced_buffers.clear();
+
+    defrag_pass_active = false;
+
+    if (vmaEndDefragmentationPass(allocator, defragmentation, &defrag_pass) == VK_SUCCESS) {
+        EndDefragmentation();
+    }
+}
+
+void DefragmentVulkanMemory(VkCommandBuffer cmd_buf, u32 frames_in_flight) {
+    if (defrag_pass_active) {
+        if (DeletionQueue::frame < defrag_pass_frame + frames_in_flight) {
+            return;
+        }
+
+        EndDefragmentationPass();
+    }
+
+    if (!defragmentation) {
+        if (++frames_since_defrag_check < VULKAN_DEFRAG_INTERVAL) {
+            return;
+        }
+
+        frames_since_defrag_check = 0;
+        BeginDefragmentation();
+
+        if (!defragmentation) {
+            return;
+        }
+    }
+
+    if (vmaBeginDefragmentationPass(allocator, defragmentation, &defrag_pass) == VK_SUCCESS) {
+        EndDefragmentation();
+        return;
+    }
+
+    GPU_SCOPE(cmd_buf, "Defragmentation");
+
+    // Earlier frames only read the old buffers, so the copies need no barrier before them
+    for (u32 i = 0; i < defrag_pass.moveCount; ++i) {
+        VmaDefragmentationMove *move = &defrag_pass.pMoves[i];
+
+        auto movable = movable_buffers.find(move->srcAllocation);
+        if (movable == movable_buffers.end()) {
+            move->operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+            continue;
+        }
+
+        MovableBuffer *buffer = &movable->second;
+
+        VkBuffer new_buffer;
+        VK_CHECK(vkCreateBuffer(VulkanDevice::handle, &buffer->create_info, 0, &new_buffer));
+        VK_CHECK(vmaBindBufferMemory(allocator, move->dstTmpAllocation, new_buffer));
+
+        VkBufferCopy region = {};
+        region.size = buffer->create_info.size;
+        vkCmdCopyBuffer(cmd_buf, *buffer->buffer, new_buffer, 1, &region);
+
+        // Descriptors are pushed every frame from the buffer handles, so replacing those is all the
+        // patching needed. The old handle goes with the pass, frames in flight may still use it.
+        replaced_buffers.push_back(*buffer->buffer);
+        *buffer->buffer = new_buffer;
+    }
+
+    VkMemoryBarrier barrier = { VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+    vkCmdPipelineBarrier(cmd_buf, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, 0, 1, &barrier, 0, 0, 0, 0);
+
+    defrag_pass_active = true;
+    defrag_pass_frame = DeletionQueue::frame;
+}
@@ -1,14 +1,61 @@
 #ifndef VULKAN_ALLOCATOR_H
 #define VULKAN_ALLOCATOR_H
 
+// Staging allocations come from a ring buffer of this size, larger ones from the general heap
+#define VULKAN_STAGING_POOL_SIZE (64ull * 1024 * 1024)
+
+// Frames between checks whether the geometry needs defragmenting
+#define VULKAN_DEFRAG_INTERVAL 600
+// Unused space in the geometry blocks, in percent, from which it is defragmented
+#define VULKAN_DEFRAG_THRESHOLD 25
+// Limits of a single pass. Its copies are all recorded into one frame, which bounds their GPU time.
+#define VULKAN_DEFRAG_MAX_BYTES (16ull * 1024 * 1024)
+#define VULKAN_DEFRAG_MAX_MOVES 128
+
+// Every allocation is tagged with one, to see what the memory goes to.
+// Each category has its own VMA pools, so long lived and short lived data don't share blocks.
+enum class MemoryCategory : u32 {
+    Geometry,
+    Textures,
+    RenderTargets,
+    Staging,
+    Other,
+    Count
+};
+
 void CreateVulkanAllocator();
 void DestroyVulkanAllocator();
 
-VmaAllocation AllocateVulkanBuffer(VkBufferCreateInfo buffer_create_info, VmaMemoryUsage usage, VkBuffer *buffer, void **mapped);
+// Geometry buffers can be moved by defragmentation, which replaces the handle in buffer.
+// So for those buffer has to stay at the same address until the buffer is freed.
+VmaAllocation AllocateVulkanBuffer(VkBufferCreateInfo buffer_create_info, VmaMemoryUsage usage, MemoryCategory category, VkBuffer *buffer, void **mapped);
 void FreeVulkanBuffer(VkBuffer buffer, VmaAllocation allocation);
 void FreeVulkanBufferNoUnmap(VkBuffer buffer, VmaAllocation allocation);
+// Keeps defragmentation from moving the buffer, for when the owner of the handle goes away before it's freed
+void PinVulkanBuffer(VmaAllocation allocation);
+// Makes GPU writes visible to mapped memory that isn't host coherent
+void InvalidateVulkanBuffer(VmaAllocation allocation);
 
-VmaAllocation AllocateVulkanImage(VkImageCreateInfo image_create_info, VmaMemoryUsage usage, VkImage *image);
+VmaAllocation AllocateVulkanImage(VkImageCreateInfo image_create_info, VmaMemoryUsage usage, MemoryCategory category, VkImage *image);
 void FreeVulkanImage(VkImage image, VmaAllocation allocation);
 
-#endif
\ No newline at end of file
+// Bytes in live allocations, without the unused parts of VMA's blocks
+u64 GetVulkanMemoryUsage();
+u64 GetVulkanMemoryUsage(MemoryCategory category);
+const char *GetMemoryCategoryName(MemoryCategory category);
+
+// Summed over the device local heaps. Comes from VK_EXT_memory_budget when the device has it,
+// otherwise VMA estimates it from its own blocks and the heap sizes.
+void GetVulkanMemoryBudget(u64 *usage, u64 *budget);
+
+// Usage and budget of every heap and the bytes of every category
+void LogVulkanMemory();
+// Writes VMA's detailed JSON statistics, allocations are named after their category
+void DumpVulkanMemory(const char *file_path);
+
+// Call once per frame at the start of its command buffer. Every VULKAN_DEFRAG_INTERVAL frames it checks
+// the geometry pools, and while one is fragmented it records the copies of one pass into the frame.
+// The pass ends once that frame's fence was waited on, so nothing ever waits for the queue.
+void DefragmentVulkanMemory(VkCommandBuffer cmd_buf, u32 frames_in_flight);
+
+#endif
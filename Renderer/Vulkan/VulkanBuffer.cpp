@@ -3,7 +3,9 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
-static VmaAllocation CreateVulkanBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage mem_usage, VkBuffer *buffer, void **mapped) {
+#include "Core/KTX2.h"
+
+static VmaAllocation CreateVulkanBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VmaMemoryUsage mem_usage, MemoryCategory category, VkBuffer *buffer, void **mapped) {
     VkDevice device = VulkanDevice::handle;
     
     VkBufferCreateInfo info = {};
@@ -12,7 +14,7 @@ static VmaAllocation CreateVulkanBuffer(VkDeviceSize size, VkBufferUsageFlags us
     info.usage = usage;
     info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
-    return AllocateVulkanBuffer(info, mem_usage, buffer, mapped);
+    return AllocateVulkanBuffer(info, mem_usage, category, buffer, mapped);
 }
 
 static VkCommandBuffer BeginSingleTimeCommands(VkCommandPool pool) {
@@ -67,54 +69,212 @@ static void CopyBuffer(VkBuffer src, VkBuffer dst, VkDeviceSize size, VkCommandP
     EndSingleTimeCommands(command_buffer, command_pool);
 }
 
-static void CopyBufferToImage(VkBuffer src, VkImage image, u32 width, u32 height, VkCommandPool pool) {
-    VkCommandBuffer command_buffer = BeginSingleTimeCommands(pool);
+void ReadImagePixels(Image *image, VkImageLayout layout, VkCommandPool command_pool, array<u8> *pixels) {
+    VkDeviceSize size = VkDeviceSize(image->width) * image->height * 4;
+
+    void *mapped;
+    VkBuffer readback_buffer;
+    VmaAllocation readback_allocation = CreateVulkanBuffer(
+        size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU, MemoryCategory::Staging, &readback_buffer, &mapped
+    );
+
+    VkCommandBuffer command_buffer = BeginSingleTimeCommands(command_pool);
+
+    // Whatever wrote the image last has to finish first
+    VkImageMemoryBarrier to_transfer = CreateBarrier(
+        image->handle, VK_ACCESS_MEMORY_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+        layout, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
+    );
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &to_transfer);
 
     VkBufferImageCopy region = {};
-    region.bufferOffset      = 0;
-    region.bufferRowLength   = 0;
-    region.bufferImageHeight = 0;
-    region.imageSubresource.aspectMask     = VK_IMAGE_ASPECT_COLOR_BIT;
-    region.imageSubresource.mipLevel       = 0;
-    region.imageSubresource.baseArrayLayer = 0;
-    region.imageSubresource.layerCount     = 1;
+    region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    region.imageSubresource.layerCount = 1;
+    region.imageExtent.width = image->width;
+    region.imageExtent.height = image->height;
+    region.imageExtent.depth = 1;
+    vkCmdCopyImageToBuffer(command_buffer, image->handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, readback_buffer, 1, &region);
+
+    VkImageMemoryBarrier to_layout = CreateBarrier(
+        image->handle, VK_ACCESS_TRANSFER_READ_BIT, 0,
+        VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, layout, VK_IMAGE_ASPECT_COLOR_BIT
+    );
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, 0, 0, 0, 1, &to_layout);
+
+    EndSingleTimeCommands(command_buffer, command_pool);
 
-    region.imageOffset = {0, 0, 0};
-    region.imageExtent = {width, height, 1};
+    InvalidateVulkanBuffer(readback_allocation);
 
-    vkCmdCopyBufferToImage(command_buffer, src, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+    pixels->resize(size);
+    memcpy(pixels->data(), mapped, size);
 
-    EndSingleTimeCommands(command_buffer, pool);
+    FreeVulkanBuffer(readback_buffer, readback_allocation);
 }
 
-static void TransitionImageLayout(VkImage image, VkFormat format, VkImageLayout old_layout, VkImageLayout new_layout, VkCommandPool pool) {
-    VkCommandBuffer command_buffer = BeginSingleTimeCommands(pool);
+struct TextureLevel {
+    const void *data;
+    VkDeviceSize size;
+};
 
-    VkPipelineStageFlags src_stage;
-    VkPipelineStageFlags dst_stage;
-    VkAccessFlags src_access;
-    VkAccessFlags dst_access;
+u32 CalculateMipLevels(u32 width, u32 height) {
+    u32 levels = 1;
+    u32 size = width > height ? width : height;
 
-    if (old_layout == VK_IMAGE_LAYOUT_UNDEFINED && new_layout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL) {
-        src_access = 0;
-        dst_access = VK_ACCESS_TRANSFER_WRITE_BIT;
-        src_stage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-        dst_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    } else {
-        src_access = VK_ACCESS_TRANSFER_WRITE_BIT;
-        dst_access = VK_ACCESS_SHADER_READ_BIT;
-        src_stage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-        dst_stage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+    while (size > 1) {
+        size >>= 1;
+        levels++;
+    }
+
+    return levels;
+}
+
+static bool SupportsBlitMipmaps(VkFormat format) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(VulkanPhysicalDevice::handle, format, &properties);
+
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+
+    return (properties.optimalTilingFeatures & required) == required;
+}
+
+// Box filters an RGBA8 image into the next mip level.
+// Only used when the device can't blit the format, so filtering in gamma space is acceptable.
+static void DownsampleRGBA8(const u8 *src, u32 src_width, u32 src_height, u8 *dst, u32 dst_width, u32 dst_height) {
+    for (u32 y = 0; y < dst_height; ++y) {
+        for (u32 x = 0; x < dst_width; ++x) {
+            u32 x0 = (x * 2) < src_width ? x * 2 : src_width - 1;
+            u32 y0 = (y * 2) < src_height ? y * 2 : src_height - 1;
+            u32 x1 = (x0 + 1) < src_width ? x0 + 1 : x0;
+            u32 y1 = (y0 + 1) < src_height ? y0 + 1 : y0;
+
+            for (u32 c = 0; c < 4; ++c) {
+                u32 sum = src[(y0 * src_width + x0) * 4 + c] + src[(y0 * src_width + x1) * 4 + c] +
+                          src[(y1 * src_width + x0) * 4 + c] + src[(y1 * src_width + x1) * 4 + c];
+
+                dst[(y * dst_width + x) * 4 + c] = u8((sum + 2) / 4);
+            }
+        }
+    }
+}
+
+static void GenerateMipmapsBlit(VkCommandBuffer command_buffer, VkImage image, u32 width, u32 height, u32 mip_levels) {
+    s32 mip_width = s32(width);
+    s32 mip_height = s32(height);
+
+    for (u32 i = 1; i < mip_levels; ++i) {
+        VkImageMemoryBarrier to_src = CreateBarrier(
+            image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 1
+        );
+
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &to_src);
+
+        s32 next_width = mip_width > 1 ? mip_width / 2 : 1;
+        s32 next_height = mip_height > 1 ? mip_height / 2 : 1;
+
+        VkImageBlit blit = {};
+        blit.srcOffsets[1] = { mip_width, mip_height, 1 };
+        blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.srcSubresource.mipLevel = i - 1;
+        blit.srcSubresource.layerCount = 1;
+        blit.dstOffsets[1] = { next_width, next_height, 1 };
+        blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit.dstSubresource.mipLevel = i;
+        blit.dstSubresource.layerCount = 1;
+
+        vkCmdBlitImage(
+            command_buffer,
+            image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit, VK_FILTER_LINEAR
+        );
+
+        VkImageMemoryBarrier to_read = CreateBarrier(
+            image, VK_ACCESS_TRANSFER_READ_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, i - 1, 1
+        );
+
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &to_read);
+
+        mip_width = next_width;
+        mip_height = next_height;
+    }
+
+    VkImageMemoryBarrier last = CreateBarrier(
+        image, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT, mip_levels - 1, 1
+    );
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &last);
+}
+
+// Uploads the given levels and, if generate_mips is set, fills the rest of the chain on the GPU.
+// Everything is recorded into a single command buffer.
+static void UploadTexture(Image *image, TextureLevel *levels, u32 level_count, bool generate_mips, VkCommandPool command_pool) {
+    VkDeviceSize total_size = 0;
+    for (u32 i = 0; i < level_count; ++i) {
+        total_size = (total_size + 15) & ~VkDeviceSize(15);
+        total_size += levels[i].size;
+    }
+
+    VkBuffer staging_buffer;
+    void *mapped;
+    VmaAllocation staging_allocation = CreateVulkanBuffer(total_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, MemoryCategory::Staging, &staging_buffer, &mapped);
+
+    array<VkBufferImageCopy> regions(level_count);
+
+    VkDeviceSize offset = 0;
+    for (u32 i = 0; i < level_count; ++i) {
+        // Offsets have to be a multiple of the texel block size
+        offset = (offset + 15) & ~VkDeviceSize(15);
+        memcpy((u8 *) mapped + offset, levels[i].data, levels[i].size);
+
+        VkBufferImageCopy *region = &regions[i];
+        *region = {};
+        region->bufferOffset = offset;
+        region->imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region->imageSubresource.mipLevel = i;
+        region->imageSubresource.layerCount = 1;
+        region->imageExtent.width = image->width >> i ? image->width >> i : 1;
+        region->imageExtent.height = image->height >> i ? image->height >> i : 1;
+        region->imageExtent.depth = 1;
+
+        offset += levels[i].size;
     }
 
-    VkImageMemoryBarrier barrier = CreateBarrier(image, src_access, dst_access, old_layout, new_layout, VK_IMAGE_ASPECT_COLOR_BIT);
+    VkCommandBuffer command_buffer = BeginSingleTimeCommands(command_pool);
+
+    VkImageMemoryBarrier to_transfer = CreateBarrier(
+        image->handle, 0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
+    );
+
+    vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, 0, 0, 0, 1, &to_transfer);
+
+    vkCmdCopyBufferToImage(command_buffer, staging_buffer, image->handle, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, level_count, regions.data());
+
+    if (generate_mips) {
+        GenerateMipmapsBlit(command_buffer, image->handle, image->width, image->height, image->mip_levels);
+    } else {
+        VkImageMemoryBarrier to_read = CreateBarrier(
+            image->handle, VK_ACCESS_TRANSFER_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT,
+            VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
+        );
+
+        vkCmdPipelineBarrier(command_buffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, 0, 0, 0, 1, &to_read);
+    }
 
-    vkCmdPipelineBarrier(command_buffer, src_stage, dst_stage, 0, 0, 0, 0, 0, 1, &barrier);
+    EndSingleTimeCommands(command_buffer, command_pool);
 
-    EndSingleTimeCommands(command_buffer, pool);
+    FreeVulkanBuffer(staging_buffer, staging_allocation);
 }
 
-void Image::Create(VkFormat format, u32 width, u32 height, u32 mip_levels, VkSampleCountFlagBits samples, VkImageUsageFlags usage) {
+void Image::Create(VkFormat format, u32 width, u32 height, u32 mip_levels, VkSampleCountFlagBits samples, VkImageUsageFlags usage, MemoryCategory category) {
+    this->format = format;
+    this->width = width;
+    this->height = height;
+    this->mip_levels = mip_levels;
+
     VkImageCreateInfo image_info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
     image_info.imageType = VK_IMAGE_TYPE_2D;
     image_info.format = format;
@@ -128,7 +288,7 @@ void Image::Create(VkFormat format, u32 width, u32 height, u32 mip_levels, VkSam
     image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
     image_info.usage = usage;
 
-    allocation = AllocateVulkanImage(image_info, VMA_MEMORY_USAGE_GPU_ONLY, &handle);
+    allocation = AllocateVulkanImage(image_info, VMA_MEMORY_USAGE_GPU_ONLY, category, &handle);
 
     VkImageAspectFlags aspect_mask = (format == VK_FORMAT_D32_SFLOAT) ? VK_IMAGE_ASPECT_DEPTH_BIT : VK_IMAGE_ASPECT_COLOR_BIT;
 
@@ -145,57 +305,80 @@ void Image::Create(VkFormat format, u32 width, u32 height, u32 mip_levels, VkSam
     VK_CHECK(vkCreateImageView(device, &view_info, 0, &view));
 }
 
-void Image::Create(const char *filename, VkCommandPool command_pool) {
-    int width, height, channels;
-    u8 *pixels = stbi_load(filename, &width, &height, &channels, STBI_rgb_alpha);
-    VkDeviceSize image_size = width * height * channels;
-
-    if (!pixels) {
-        LogFatal("Failed to load image file '%s'", filename);
+// level_count == 1 builds the full mip chain, otherwise the given levels are uploaded as is
+static void CreateTexture(Image *image, VkFormat format, u32 width, u32 height, TextureLevel *levels, u32 level_count, VkCommandPool command_pool) {
+    bool generate_mips = level_count == 1 && CalculateMipLevels(width, height) > 1;
+
+    image->format = format;
+    image->width = width;
+    image->height = height;
+    image->mip_levels = generate_mips ? CalculateMipLevels(width, height) : level_count;
+
+    // Formats the device can't blit get their chain built on the CPU instead.
+    // A compute downsampler can't help here, sRGB formats are not usable as storage images.
+    array<array<u8>> cpu_levels;
+    array<TextureLevel> uploaded_levels(levels, levels + level_count);
+
+    if (generate_mips && !SupportsBlitMipmaps(format)) {
+        if (format != VK_FORMAT_R8G8B8A8_SRGB && format != VK_FORMAT_R8G8B8A8_UNORM) {
+            LogError("Can't generate mipmaps for format %d", format);
+            image->mip_levels = 1;
+        }
+
+        cpu_levels.resize(image->mip_levels);
+        for (u32 i = 1; i < image->mip_levels; ++i) {
+            u32 src_width = width >> (i - 1) ? width >> (i - 1) : 1;
+            u32 src_height = height >> (i - 1) ? height >> (i - 1) : 1;
+            u32 dst_width = width >> i ? width >> i : 1;
+            u32 dst_height = height >> i ? height >> i : 1;
+
+            const u8 *src = (const u8 *) uploaded_levels[i - 1].data;
+            cpu_levels[i].resize(dst_width * dst_height * 4);
+            DownsampleRGBA8(src, src_width, src_height, cpu_levels[i].data(), dst_width, dst_height);
+
+            uploaded_levels.push_back({ cpu_levels[i].data(), cpu_levels[i].size() });
+        }
+
+        generate_mips = false;
     }
 
-    VkBuffer staging_buffer;
-    void *mapped;
-    VmaAllocation staging_allocation = CreateVulkanBuffer(image_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, &staging_buffer, &mapped);
-
-    memcpy(mapped, pixels, image_size);
-
     VkImageCreateInfo image_info = { VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO };
     image_info.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
     image_info.imageType = VK_IMAGE_TYPE_2D;
     image_info.extent.width = width;
     image_info.extent.height = height;
     image_info.extent.depth = 1;
-    // TODO: Support mipmaps
-    image_info.mipLevels = 1;
+    image_info.mipLevels = image->mip_levels;
     image_info.arrayLayers = 1;
-    image_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+    image_info.format = format;
     image_info.tiling = VK_IMAGE_TILING_OPTIMAL;
     image_info.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-    image_info.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+    image_info.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
     image_info.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
     // TODO: Support multisampling
     image_info.samples = VK_SAMPLE_COUNT_1_BIT;
 
-    allocation = AllocateVulkanImage(image_info, VMA_MEMORY_USAGE_GPU_ONLY, &handle);
+    image->allocation = AllocateVulkanImage(image_info, VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Textures, &image->handle);
 
-    CopyBufferToImage(staging_buffer, handle, width, height, command_pool);
-    TransitionImageLayout(handle, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, command_pool);
-
-    stbi_image_free(pixels);
-    FreeVulkanBuffer(staging_buffer, staging_allocation);
+    UploadTexture(image, uploaded_levels.data(), u32(uploaded_levels.size()), generate_mips, command_pool);
 
     VkImageViewCreateInfo view_info = { VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO };
-    view_info.image = handle;
+    view_info.image = image->handle;
     view_info.viewType = VK_IMAGE_VIEW_TYPE_2D;
-    view_info.format = VK_FORMAT_R8G8B8A8_SRGB;
+    view_info.format = format;
     view_info.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
     view_info.subresourceRange.baseMipLevel = 0;
-    view_info.subresourceRange.levelCount = 1;
+    view_info.subresourceRange.levelCount = image->mip_levels;
     view_info.subresourceRange.layerCount = 1;
 
     VkDevice device = VulkanDevice::handle;
-    VK_CHECK(vkCreateImageView(device, &view_info, 0, &view));
+    VK_CHECK(vkCreateImageView(device, &view_info, 0, &image->view));
+
+    image->CreateSampler();
+}
+
+void Image::CreateSampler() {
+    VkDevice device = VulkanDevice::handle;
 
     VkSamplerCreateInfo sampler_info = { VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO };
     sampler_info.magFilter = VK_FILTER_LINEAR;
@@ -210,10 +393,55 @@ void Image::Create(const char *filename, VkCommandPool command_pool) {
     sampler_info.compareEnable = VK_FALSE;
     sampler_info.compareOp = VK_COMPARE_OP_ALWAYS;
     sampler_info.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+    sampler_info.minLod = 0.0f;
+    sampler_info.maxLod = f32(mip_levels);
 
     VK_CHECK(vkCreateSampler(device, &sampler_info, 0, &sampler));
 }
 
+bool IsTextureFormatSupported(VkFormat format) {
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(VulkanPhysicalDevice::handle, format, &properties);
+
+    return (properties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT) != 0;
+}
+
+void Image::Create(const char *filename, VkCommandPool command_pool) {
+    // Prefer the output of the AssetCooker, its block compressed levels are uploaded without decoding.
+    // Devices without BC support fall back to decoding the source image.
+    string cooked_path = string(filename) + ".ktx2";
+    if (IsCookedFileUpToDate(filename, cooked_path.c_str())) {
+        KTX2Texture texture;
+        if (texture.Load(cooked_path.c_str()) && IsTextureFormatSupported(texture.format)) {
+            array<TextureLevel> levels;
+            for (array<u8> &level : texture.levels) {
+                levels.push_back({ level.data(), level.size() });
+            }
+
+            CreateTexture(this, texture.format, texture.width, texture.height, levels.data(), u32(levels.size()), command_pool);
+            return;
+        }
+    }
+
+    int width, height, channels;
+    u8 *pixels = stbi_load(filename, &width, &height, &channels, STBI_rgb_alpha);
+    VkDeviceSize image_size = VkDeviceSize(width) * VkDeviceSize(height) * 4;
+
+    if (!pixels) {
+        LogFatal("Failed to load image file '%s'", filename);
+    }
+
+    TextureLevel level = { pixels, image_size };
+    CreateTexture(this, VK_FORMAT_R8G8B8A8_SRGB, width, height, &level, 1, command_pool);
+
+    stbi_image_free(pixels);
+}
+
+void Image::Create(const u8 *pixels, u32 width, u32 height, VkCommandPool command_pool) {
+    TextureLevel level = { pixels, VkDeviceSize(width) * height * 4 };
+    CreateTexture(this, VK_FORMAT_R8G8B8A8_SRGB, width, height, &level, 1, command_pool);
+}
+
 void Image::Destroy() {
     VkDevice device = VulkanDevice::handle;
 
@@ -226,7 +454,11 @@ void Image::Destroy() {
     FreeVulkanImage(handle, allocation);
 }
 
-VkImageMemoryBarrier CreateBarrier(VkImage image, VkAccessFlags src_access, VkAccessFlags dst_access, VkImageLayout old_layout, VkImageLayout new_layout, VkImageAspectFlags aspect_mask) {
+void Image::Release() {
+    DeletionQueue::ReleaseImage(this);
+}
+
+VkImageMemoryBarrier CreateBarrier(VkImage image, VkAccessFlags src_access, VkAccessFlags dst_access, VkImageLayout old_layout, VkImageLayout new_layout, VkImageAspectFlags aspect_mask, u32 base_mip_level, u32 level_count) {
     VkImageMemoryBarrier barrier = { VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER };
     barrier.srcAccessMask = src_access;
     barrier.dstAccessMask = dst_access;
@@ -236,26 +468,27 @@ VkImageMemoryBarrier CreateBarrier(VkImage image, VkAccessFlags src_access, VkAc
     barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
     barrier.image = image;
     barrier.subresourceRange.aspectMask = aspect_mask;
-    barrier.subresourceRange.baseMipLevel = 0;
-    barrier.subresourceRange.levelCount = 1;
+    barrier.subresourceRange.baseMipLevel = base_mip_level;
+    barrier.subresourceRange.levelCount = level_count;
     barrier.subresourceRange.baseArrayLayer = 0;
     barrier.subresourceRange.layerCount = 1;
 
     return barrier;
 }
 
-void StorageBuffer::Create(void *data, VkDeviceSize size, VkCommandPool command_pool) {
-    Create(size);
+void StorageBuffer::Create(void *data, VkDeviceSize size, VkCommandPool command_pool, MemoryCategory category) {
+    Create(size, category);
     SetData(data, size, command_pool);
 }
 
-void StorageBuffer::Create(VkDeviceSize size) {
+void StorageBuffer::Create(VkDeviceSize size, MemoryCategory category) {
     this->size = size;
 
     allocation = CreateVulkanBuffer(
         size,
         VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
         VMA_MEMORY_USAGE_GPU_ONLY,
+        category,
         &buffer, 0
     );
 }
@@ -264,10 +497,14 @@ void StorageBuffer::Destroy() {
     FreeVulkanBufferNoUnmap(buffer, allocation);
 }
 
+void StorageBuffer::Release() {
+    DeletionQueue::ReleaseBuffer(buffer, allocation, false);
+}
+
 void StorageBuffer::SetData(void *data, VkDeviceSize size, VkCommandPool command_pool) {
     VkBuffer staging_buffer;
     void *mapped;
-    VmaAllocation staging_allocation = CreateVulkanBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &staging_buffer, &mapped);
+    VmaAllocation staging_allocation = CreateVulkanBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::Staging, &staging_buffer, &mapped);
     memcpy(mapped, data, size);
     
     CopyBuffer(staging_buffer, buffer, size, command_pool);
@@ -282,11 +519,13 @@ void IndexBuffer::Create(u32 *data, u32 count, VkCommandPool command_pool) {
 
     VkBuffer staging_buffer;
     void *mapped;
-    VmaAllocation staging_allocation = CreateVulkanBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &staging_buffer, &mapped);
+    VmaAllocation staging_allocation = CreateVulkanBuffer(size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::Staging, &staging_buffer, &mapped);
 
     memcpy(mapped, data, size);
     
-    CreateVulkanBuffer(size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &buffer, 0);
+    allocation = CreateVulkanBuffer(
+        size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Geometry, &buffer, 0
+    );
     CopyBuffer(staging_buffer, buffer, size, command_pool);
 
     FreeVulkanBuffer(staging_buffer, staging_allocation);
@@ -296,6 +535,10 @@ void IndexBuffer::Destroy() {
     FreeVulkanBufferNoUnmap(buffer, allocation);
 }
 
+void IndexBuffer::Release() {
+    DeletionQueue::ReleaseBuffer(buffer, allocation, false);
+}
+
 void RenderImages::Create(VulkanSwapchain *swapchain) {
     color_image.Create(
         swapchain->format,
@@ -303,9 +546,29 @@ void RenderImages::Create(VulkanSwapchain *swapchain) {
         swapchain->extent.height,
         1,
         VK_SAMPLE_COUNT_1_BIT,
-        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT 
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
+    );
+
+    velocity_image.Create(
+        RENDER_VELOCITY_FORMAT,
+        swapchain->extent.width,
+        swapchain->extent.height,
+        1,
+        VK_SAMPLE_COUNT_1_BIT,
+        VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT
     );
 
+    for (Image &history_image : history_images) {
+        history_image.Create(
+            RENDER_HISTORY_FORMAT,
+            swapchain->extent.width,
+            swapchain->extent.height,
+            1,
+            VK_SAMPLE_COUNT_1_BIT,
+            VK_IMAGE_USAGE_STORAGE_BIT | VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT
+        );
+    }
+
     depth_image.Create(
         VK_FORMAT_D32_SFLOAT,
         swapchain->extent.width,
@@ -319,4 +582,15 @@ void RenderImages::Create(VulkanSwapchain *swapchain) {
 void RenderImages::Destroy() {
     color_image.Destroy();
     depth_image.Destroy();
+    velocity_image.Destroy();
+    history_images[0].Destroy();
+    history_images[1].Destroy();
+}
+
+void RenderImages::Release() {
+    color_image.Release();
+    depth_image.Release();
+    velocity_image.Release();
+    history_images[0].Release();
+    history_images[1].Release();
 }
@@ -6,13 +6,31 @@ struct Image {
     VkSampler sampler = VK_NULL_HANDLE;
     VkImageView view;
     VmaAllocation allocation;
+    VkFormat format = VK_FORMAT_UNDEFINED;
+    u32 width = 0;
+    u32 height = 0;
+    u32 mip_levels = 1;
 
-    void Create(VkFormat format, u32 width, u32 height, u32 mip_levels, VkSampleCountFlagBits samples, VkImageUsageFlags usage);
+    void Create(VkFormat format, u32 width, u32 height, u32 mip_levels, VkSampleCountFlagBits samples, VkImageUsageFlags usage, MemoryCategory category=MemoryCategory::RenderTargets);
     void Create(const char *filename, VkCommandPool command_pool);
+    // sRGB RGBA8 pixels, tightly packed, the mip chain is generated
+    void Create(const u8 *pixels, u32 width, u32 height, VkCommandPool command_pool);
+    // Trilinear, anisotropic and repeating over all mip levels
+    void CreateSampler();
     void Destroy();
+    // Destroys it once the frames in flight are done with it
+    void Release();
 };
 
-VkImageMemoryBarrier CreateBarrier(VkImage image, VkAccessFlags src_access, VkAccessFlags dst_access, VkImageLayout old_layout, VkImageLayout new_layout, VkImageAspectFlags aspect_mask);
+// Covers every mip level by default
+VkImageMemoryBarrier CreateBarrier(VkImage image, VkAccessFlags src_access, VkAccessFlags dst_access, VkImageLayout old_layout, VkImageLayout new_layout, VkImageAspectFlags aspect_mask, u32 base_mip_level=0, u32 level_count=VK_REMAINING_MIP_LEVELS);
+
+// Copies the first mip level of a 4 byte per pixel image into pixels, tightly packed.
+// The image has to be in layout and is left in it, waits for the copy to finish.
+void ReadImagePixels(Image *image, VkImageLayout layout, VkCommandPool command_pool, array<u8> *pixels);
+
+u32 CalculateMipLevels(u32 width, u32 height);
+bool IsTextureFormatSupported(VkFormat format);
 
 struct StorageBuffer {
     VkBuffer buffer;
@@ -20,9 +38,10 @@ struct StorageBuffer {
     void *mapped = 0;
     VkDeviceSize size;
 
-    void Create(void *data, VkDeviceSize size, VkCommandPool command_pool);
-    void Create(VkDeviceSize size);
+    void Create(void *data, VkDeviceSize size, VkCommandPool command_pool, MemoryCategory category=MemoryCategory::Other);
+    void Create(VkDeviceSize size, MemoryCategory category=MemoryCategory::Other);
     void Destroy();
+    void Release();
 
     void SetData(void *data, VkDeviceSize size, VkCommandPool command_pool);
 };
@@ -34,16 +53,25 @@ struct IndexBuffer {
 
     void Create(u32 *data, u32 count, VkCommandPool command_pool);
     void Destroy();
+    void Release();
 };
 
 // Should probably move this
 struct VulkanSwapchain;
+// Screen space motion in uv units, written by the main pass next to the color
+#define RENDER_VELOCITY_FORMAT VK_FORMAT_R16G16_SFLOAT
+#define RENDER_HISTORY_FORMAT VK_FORMAT_R16G16B16A16_SFLOAT
+
 struct RenderImages {
     Image color_image;
     Image depth_image;
-    
+    Image velocity_image;
+    // Temporal upsampling output, ping-ponged between frames
+    Image history_images[2];
+
     void Create(VulkanSwapchain *swapchain);
     void Destroy();
+    void Release();
 };
 
 #endif
@@ -0,0 +1,96 @@
+#include "VulkanRenderer.h"
+
+array<PendingDeletion> DeletionQueue::pending;
+u64 DeletionQueue::frame = 0;
+
+static void DestroyPending(PendingDeletion *deletion) {
+    VkDevice device = VulkanDevice::handle;
+
+    if (deletion->view != VK_NULL_HANDLE) {
+        vkDestroyImageView(device, deletion->view, 0);
+    }
+    if (deletion->sampler != VK_NULL_HANDLE) {
+        vkDestroySampler(device, deletion->sampler, 0);
+    }
+    if (deletion->image != VK_NULL_HANDLE) {
+        FreeVulkanImage(deletion->image, deletion->allocation);
+    }
+    if (deletion->buffer != VK_NULL_HANDLE) {
+        if (deletion->unmap) {
+            FreeVulkanBuffer(deletion->buffer, deletion->allocation);
+        } else {
+            FreeVulkanBufferNoUnmap(deletion->buffer, deletion->allocation);
+        }
+    }
+    if (deletion->swapchain != VK_NULL_HANDLE) {
+        vkDestroySwapchainKHR(device, deletion->swapchain, 0);
+    }
+}
+
+void DeletionQueue::ReleaseBuffer(VkBuffer buffer, VmaAllocation allocation, bool unmap) {
+    // Whoever owns the handle may be gone before the buffer is destroyed
+    PinVulkanBuffer(allocation);
+
+    PendingDeletion deletion;
+    deletion.frame = frame;
+    deletion.buffer = buffer;
+    deletion.allocation = allocation;
+    deletion.unmap = unmap;
+
+    pending.push_back(deletion);
+}
+
+void DeletionQueue::ReleaseImage(Image *image) {
+    PendingDeletion deletion;
+    deletion.frame = frame;
+    deletion.image = image->handle;
+    deletion.allocation = image->allocation;
+    deletion.view = image->view;
+    deletion.sampler = image->sampler;
+
+    pending.push_back(deletion);
+}
+
+void DeletionQueue::ReleaseView(VkImageView view) {
+    PendingDeletion deletion;
+    deletion.frame = frame;
+    deletion.view = view;
+
+    pending.push_back(deletion);
+}
+
+void DeletionQueue::ReleaseSwapchain(VkSwapchainKHR swapchain) {
+    PendingDeletion deletion;
+    deletion.frame = frame;
+    deletion.swapchain = swapchain;
+
+    pending.push_back(deletion);
+}
+
+void DeletionQueue::EndFrame() {
+    frame++;
+}
+
+void DeletionQueue::Collect(u32 frames_in_flight) {
+    if (frame < frames_in_flight) {
+        return;
+    }
+
+    u64 completed = frame - frames_in_flight;
+
+    u64 count = 0;
+    while (count < pending.size() && pending[count].frame <= completed) {
+        DestroyPending(&pending[count]);
+        count++;
+    }
+
+    pending.erase(pending.begin(), pending.begin() + count);
+}
+
+void DeletionQueue::Flush() {
+    for (PendingDeletion &deletion : pending) {
+        DestroyPending(&deletion);
+    }
+
+    pending.clear();
+}
@@ -0,0 +1,40 @@
+#ifndef VULKAN_DELETION_QUEUE_H
+#define VULKAN_DELETION_QUEUE_H
+
+// Whatever is set gets destroyed, views and samplers before the image they belong to
+struct PendingDeletion {
+    u64 frame;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    VkImage image = VK_NULL_HANDLE;
+    VmaAllocation allocation = VK_NULL_HANDLE;
+    VkImageView view = VK_NULL_HANDLE;
+    VkSampler sampler = VK_NULL_HANDLE;
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
+    // Buffers that were mapped with vmaMapMemory
+    bool unmap = false;
+};
+
+// Resources that frames in flight may still use, destroyed once those frames are done.
+// Every entry is tagged with the frame being recorded when it was released. RenderPass::BeginFrame
+// waits on the fence of the frame frames_in_flight before the one it begins, so everything released
+// while that one or an earlier one was recorded can go. Releasing never has to wait on the device.
+struct DeletionQueue {
+    // In release order, so also ordered by frame
+    static array<PendingDeletion> pending;
+    // Frames submitted so far, the one being recorded has this index
+    static u64 frame;
+
+    static void ReleaseBuffer(VkBuffer buffer, VmaAllocation allocation, bool unmap);
+    static void ReleaseImage(Image *image);
+    static void ReleaseView(VkImageView view);
+    // The swapchain has to be retired already, passed as oldSwapchain to its replacement
+    static void ReleaseSwapchain(VkSwapchainKHR swapchain);
+
+    static void EndFrame();
+    // Call after waiting on the fence of the frame about to be recorded
+    static void Collect(u32 frames_in_flight);
+    // Destroys everything, the device has to be idle
+    static void Flush();
+};
+
+#endif
@@ -6,9 +6,25 @@ PFN_vkCmdPushDescriptorSetWithTemplateKHR vkCmdPushDescriptorSetWithTemplateFunc
 VkPhysicalDevice VulkanPhysicalDevice::handle = 0;
 VkPhysicalDeviceMemoryProperties VulkanPhysicalDevice::memory_properties = {};
 VkPhysicalDeviceProperties VulkanPhysicalDevice::properties = {};
+VkPhysicalDeviceFeatures VulkanPhysicalDevice::features = {};
 u32 VulkanPhysicalDevice::graphics = 0;
 u32 VulkanPhysicalDevice::present = 0;
 VkSampleCountFlagBits VulkanPhysicalDevice::msaa_samples = VK_SAMPLE_COUNT_1_BIT;
+bool VulkanPhysicalDevice::memory_budget_supported = false;
+
+static u32 DeviceTypeRank(VkPhysicalDeviceType type, bool prefer_software) {
+    if (prefer_software && type == VK_PHYSICAL_DEVICE_TYPE_CPU) {
+        return 5;
+    }
+
+    switch (type) {
+        case VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU: return 4;
+        case VK_PHYSICAL_DEVICE_TYPE_INTEGRATED_GPU: return 3;
+        case VK_PHYSICAL_DEVICE_TYPE_VIRTUAL_GPU: return 2;
+        case VK_PHYSICAL_DEVICE_TYPE_CPU: return 1;
+        default: return 0;
+    }
+}
 
 void VulkanPhysicalDevice::Pick(VulkanContext *ctx) {
     u32 device_count;
@@ -17,12 +33,17 @@ void VulkanPhysicalDevice::Pick(VulkanContext *ctx) {
     array<VkPhysicalDevice> devices(device_count);
     VK_CHECK(vkEnumeratePhysicalDevices(VulkanInstance::handle, &device_count, devices.data()));
 
+    // Prefer real GPUs, but software rasterizers like lavapipe or SwiftShader still work
+    // for headless runs on machines without one
+    u32 best_rank = 0;
+
     for (VkPhysicalDevice dev : devices) {
         VkPhysicalDeviceProperties properties;
 
         vkGetPhysicalDeviceProperties(dev, &properties);
 
-        if (properties.deviceType != VK_PHYSICAL_DEVICE_TYPE_DISCRETE_GPU) {
+        u32 rank = DeviceTypeRank(properties.deviceType, ctx->prefer_software);
+        if (rank <= best_rank) {
             continue;
         }
 
@@ -59,12 +80,19 @@ void VulkanPhysicalDevice::Pick(VulkanContext *ctx) {
 
             VkBool32 present_support = false;
 
-            vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, VulkanInstance::surface, &present_support);
+            if (VulkanInstance::surface) {
+                vkGetPhysicalDeviceSurfaceSupportKHR(dev, i, VulkanInstance::surface, &present_support);
+            }
             if (present_support) {
                 present_index = i;
             }
         }
 
+        // Nothing is presented without a surface
+        if (!VulkanInstance::surface) {
+            present_index = graphics_index;
+        }
+
         if (graphics_index == -1 || present_index == -1) {
             continue;
         }
@@ -74,11 +102,29 @@ void VulkanPhysicalDevice::Pick(VulkanContext *ctx) {
         handle = dev;
         graphics = graphics_index;
         present = present_index;
-        break;
+        best_rank = rank;
+    }
+
+    if (handle == VK_NULL_HANDLE) {
+        LogFatal("Failed to find suitable GPU");
     }
 
     vkGetPhysicalDeviceMemoryProperties(handle, &memory_properties);
     vkGetPhysicalDeviceProperties(handle, &properties);
+    vkGetPhysicalDeviceFeatures(handle, &features);
+
+    u32 extension_count;
+    vkEnumerateDeviceExtensionProperties(handle, 0, &extension_count, 0);
+
+    array<VkExtensionProperties> extensions(extension_count);
+    vkEnumerateDeviceExtensionProperties(handle, 0, &extension_count, extensions.data());
+
+    for (VkExtensionProperties &extension : extensions) {
+        if (strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0) {
+            memory_budget_supported = true;
+            ctx->device_extensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+        }
+    }
 
     VkSampleCountFlags msaa_flags = properties.limits.framebufferColorSampleCounts & properties.limits.framebufferDepthSampleCounts;
 
@@ -93,9 +139,7 @@ void VulkanPhysicalDevice::Pick(VulkanContext *ctx) {
     // _instance->msaa_samples = samples;
     msaa_samples = VK_SAMPLE_COUNT_1_BIT;
 
-    if (handle == VK_NULL_HANDLE) {
-        LogFatal("Failed to find suitable GPU");
-    }
+    LogInfo("Using %s", properties.deviceName);
 }
 
 VkDevice VulkanDevice::handle = VK_NULL_HANDLE;
@@ -107,6 +151,9 @@ u32 VulkanDevice::present_index = ~0u;
 void VulkanDevice::Create(VulkanContext *ctx) {
     VkPhysicalDeviceFeatures features_core = {};
     features_core.sampleRateShading = VK_TRUE;
+    features_core.textureCompressionBC = VulkanPhysicalDevice::features.textureCompressionBC;
+    features_core.fillModeNonSolid = VulkanPhysicalDevice::features.fillModeNonSolid;
+    features_core.pipelineStatisticsQuery = VulkanPhysicalDevice::features.pipelineStatisticsQuery;
 
     VkPhysicalDeviceVulkan13Features features13 = { VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES };
 	features13.dynamicRendering = VK_TRUE;
@@ -116,8 +163,9 @@ void VulkanDevice::Create(VulkanContext *ctx) {
     features12.shaderInt8 = VK_TRUE;
     features12.uniformAndStorageBuffer8BitAccess = VK_TRUE;
 
-    const u32 queue_create_info_count = 2;
-    VkDeviceQueueCreateInfo queue_create_infos[queue_create_info_count];
+    // Queue families have to be unique, headless runs always use the graphics queue for both
+    u32 queue_create_info_count = VulkanPhysicalDevice::graphics == VulkanPhysicalDevice::present ? 1 : 2;
+    VkDeviceQueueCreateInfo queue_create_infos[2];
 
     f32 queue_priority = 1.0f;
 
@@ -5,9 +5,12 @@ struct VulkanPhysicalDevice {
     static VkPhysicalDevice handle;
     static VkPhysicalDeviceMemoryProperties memory_properties;
     static VkPhysicalDeviceProperties properties;
+    static VkPhysicalDeviceFeatures features;
     static u32 graphics;
     static u32 present;
     static VkSampleCountFlagBits msaa_samples;
+    // VK_EXT_memory_budget is enabled when this is set, VMA then reports what the driver says
+    static bool memory_budget_supported;
 
     static VulkanPhysicalDevice *Get();
     static void Pick(VulkanContext *ctx);
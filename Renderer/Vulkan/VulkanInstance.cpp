@@ -16,7 +16,7 @@ static bool CheckLayerSupport(const char *name) {
 	return false;
 }
 
-VulkanContext VulkanContext::Get(bool enable_layers) {
+VulkanContext VulkanContext::Get(bool enable_layers, bool headless) {
     VulkanContext ctx;
 
     if (enable_layers) {
@@ -35,22 +35,27 @@ VulkanContext VulkanContext::Get(bool enable_layers) {
         }
     }
 
-    const char **extensions;
-    u32 extension_count;
-    extensions = glfwGetRequiredInstanceExtensions(&extension_count);
+    if (!headless) {
+        const char **extensions;
+        u32 extension_count;
+        extensions = glfwGetRequiredInstanceExtensions(&extension_count);
 
-    ctx.global_extensions.resize(extension_count);
-    for (int i = 0; i < extension_count; ++i) {
-        ctx.global_extensions[i] = extensions[i];
+        ctx.global_extensions.resize(extension_count);
+        for (int i = 0; i < extension_count; ++i) {
+            ctx.global_extensions[i] = extensions[i];
+        }
     }
 
     ctx.device_extensions = {
-        VK_KHR_SWAPCHAIN_EXTENSION_NAME,
         VK_KHR_PUSH_DESCRIPTOR_EXTENSION_NAME,
         VK_KHR_16BIT_STORAGE_EXTENSION_NAME,
         VK_KHR_8BIT_STORAGE_EXTENSION_NAME
     };
 
+    if (!headless) {
+        ctx.device_extensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+    }
+
     return ctx;
 }
 
@@ -83,10 +88,14 @@ void VulkanInstance::Create(VulkanContext *ctx, GLFWwindow *window, const char *
 
     LogDev("Vulkan version %d.%d", VK_API_VERSION_MAJOR(api_version), VK_API_VERSION_MINOR(api_version));
 
-    VK_CHECK(glfwCreateWindowSurface(VulkanInstance::handle, window, 0, &surface));
+    if (window) {
+        VK_CHECK(glfwCreateWindowSurface(VulkanInstance::handle, window, 0, &surface));
+    }
 }
 
 void VulkanInstance::Destroy() {
-    vkDestroySurfaceKHR(handle, surface, 0);
+    if (surface) {
+        vkDestroySurfaceKHR(handle, surface, 0);
+    }
     vkDestroyInstance(handle, 0);
 }
@@ -5,13 +5,17 @@ struct VulkanContext {
     array<const char *> layers;
     array<const char *> global_extensions;
     array<const char *> device_extensions;
-    static VulkanContext Get(bool enable_layers);
+    // Pick a software rasterizer like lavapipe over real GPUs, for results that are the same on every machine
+    bool prefer_software = false;
+    // Headless contexts need no window system extensions and no swapchain
+    static VulkanContext Get(bool enable_layers, bool headless=false);
 };
 
 struct VulkanInstance {
     static VkInstance handle;
     static VkSurfaceKHR surface;
 
+    // Without a window no surface is created
     static void Create(VulkanContext *ctx, GLFWwindow *window, const char *name);
     static void Destroy();
 };
@@ -1,5 +1,7 @@
 #include "VulkanRenderer.h"
 
+#include <filesystem>
+
 static u32 ReadShaderFile(const char *file_name, u8 **out_buffer) {
     FILE *f = fopen(file_name, "rb");
     if (!f) {
@@ -24,6 +26,139 @@ static u32 ReadShaderFile(const char *file_name, u8 **out_buffer) {
     return file_size;
 }
 
+VkPipelineCache VulkanPipelineCache::handle = VK_NULL_HANDLE;
+string VulkanPipelineCache::path;
+bool VulkanPipelineCache::loaded = false;
+f64 VulkanPipelineCache::creation_time = 0;
+u32 VulkanPipelineCache::pipeline_count = 0;
+
+#define PIPELINE_CACHE_MAGIC 0x43505256 // VRPC
+
+// Written in front of the driver's data. The driver's own header has the UUID
+// but not the driver version, and drivers are not required to reject stale data.
+struct PipelineCacheFileHeader {
+    u32 magic;
+    u32 driver_version;
+    u32 vendor_id;
+    u32 device_id;
+    u8 uuid[VK_UUID_SIZE];
+    u64 data_size;
+};
+
+static bool ReadPipelineCacheFile(const char *path, array<u8> *data) {
+    FILE *file = fopen(path, "rb");
+    if (!file) return false;
+
+    VkPhysicalDeviceProperties *properties = &VulkanPhysicalDevice::properties;
+
+    std::error_code error;
+    u64 file_size = std::filesystem::file_size(path, error);
+
+    PipelineCacheFileHeader header;
+    bool ok = !error && fread(&header, sizeof(header), 1, file) == 1;
+
+    // A truncated or corrupt file must not decide how much is allocated
+    ok = ok && header.data_size == file_size - sizeof(header);
+    ok = ok && header.magic == PIPELINE_CACHE_MAGIC;
+    ok = ok && header.driver_version == properties->driverVersion;
+    ok = ok && header.vendor_id == properties->vendorID;
+    ok = ok && header.device_id == properties->deviceID;
+    ok = ok && memcmp(header.uuid, properties->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+
+    if (ok) {
+        data->resize(header.data_size);
+        ok = fread(data->data(), 1, header.data_size, file) == header.data_size;
+    }
+
+    // Check the driver's header as well
+    if (ok) {
+        VkPipelineCacheHeaderVersionOne cache_header;
+        ok = data->size() >= sizeof(cache_header);
+
+        if (ok) {
+            memcpy(&cache_header, data->data(), sizeof(cache_header));
+
+            ok = cache_header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE;
+            ok = ok && cache_header.vendorID == properties->vendorID;
+            ok = ok && cache_header.deviceID == properties->deviceID;
+            ok = ok && memcmp(cache_header.pipelineCacheUUID, properties->pipelineCacheUUID, VK_UUID_SIZE) == 0;
+        }
+    }
+
+    fclose(file);
+
+    if (!ok) {
+        LogDev("Pipeline cache '%s' is stale or invalid, starting cold", path);
+        data->clear();
+    }
+
+    return ok;
+}
+
+void VulkanPipelineCache::Create(const char *path) {
+    VulkanPipelineCache::path = path;
+
+    array<u8> data;
+    loaded = ReadPipelineCacheFile(path, &data);
+
+    VkPipelineCacheCreateInfo cache_info = { VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+    cache_info.initialDataSize = data.size();
+    cache_info.pInitialData = data.data();
+
+    VK_CHECK(vkCreatePipelineCache(VulkanDevice::handle, &cache_info, 0, &handle));
+}
+
+void VulkanPipelineCache::Destroy() {
+    VkDevice device = VulkanDevice::handle;
+    VkPhysicalDeviceProperties *properties = &VulkanPhysicalDevice::properties;
+
+    size_t size = 0;
+    VK_CHECK(vkGetPipelineCacheData(device, handle, &size, 0));
+
+    array<u8> data(size);
+    VK_CHECK(vkGetPipelineCacheData(device, handle, &size, data.data()));
+
+    vkDestroyPipelineCache(device, handle, 0);
+    handle = VK_NULL_HANDLE;
+
+    PipelineCacheFileHeader header = {};
+    header.magic = PIPELINE_CACHE_MAGIC;
+    header.driver_version = properties->driverVersion;
+    header.vendor_id = properties->vendorID;
+    header.device_id = properties->deviceID;
+    memcpy(header.uuid, properties->pipelineCacheUUID, VK_UUID_SIZE);
+    header.data_size = size;
+
+    // Write to a temporary file first so a crash never leaves a truncated cache behind
+    string temp_path = path + ".tmp";
+
+    FILE *file = fopen(temp_path.c_str(), "wb");
+    if (!file) {
+        LogError("Failed to write pipeline cache '%s'", temp_path.c_str());
+        return;
+    }
+
+    fwrite(&header, sizeof(header), 1, file);
+    fwrite(data.data(), 1, size, file);
+
+    bool ok = ferror(file) == 0;
+    ok = fclose(file) == 0 && ok;
+
+    std::error_code error;
+    if (ok) {
+        std::filesystem::rename(temp_path, path, error);
+    }
+
+    if (!ok || error) {
+        LogError("Failed to write pipeline cache '%s'", path.c_str());
+        std::filesystem::remove(temp_path, error);
+    }
+}
+
+void VulkanPipelineCache::LogStats() {
+    LogInfo("Created %u pipelines in %.2f ms (%s pipeline cache)", pipeline_count, creation_time, loaded ? "warm" : "cold");
+}
+
 void Shader::Create(const char *path) {
     VkShaderModuleCreateInfo shader_info = { VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO };
     shader_info.codeSize = ReadShaderFile(path, (u8 **) &shader_info.pCode);
@@ -59,34 +194,47 @@ void PipelineInfo::AddPushConstant(VkShaderStageFlags stage, u32 size) {
     push_constants.push_back(push_constant_range);
 }
 
-void Pipeline::Create(VulkanSwapchain *swapchain, PipelineInfo *info) {
-    VkDevice device = VulkanDevice::handle;
+static VkSpecializationInfo CreateSpecializationInfo(PipelineState *state, array<VkSpecializationMapEntry> *entries) {
+    for (u32 i = 0; i < PIPELINE_MAX_SPECIALIZATION; ++i) {
+        if (state->specialization_mask & (1 << i)) {
+            entries->push_back({ i, u32(i * sizeof(u32)), sizeof(u32) });
+        }
+    }
 
-    VkDescriptorSetLayoutCreateInfo set_create_info = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
-    set_create_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
-    set_create_info.bindingCount = u32(info->set_bindings.size());
-    set_create_info.pBindings = info->set_bindings.data();
+    VkSpecializationInfo specialization_info = {};
+    specialization_info.mapEntryCount = u32(entries->size());
+    specialization_info.pMapEntries = entries->data();
+    specialization_info.dataSize = sizeof(state->specialization);
+    specialization_info.pData = state->specialization;
 
-    VK_CHECK(vkCreateDescriptorSetLayout(device, &set_create_info, 0, &descriptor_set_layout));
+    return specialization_info;
+}
 
-    VkPipelineLayoutCreateInfo layout_info = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
-    layout_info.setLayoutCount = 1;
-    layout_info.pSetLayouts = &descriptor_set_layout;
-    layout_info.pushConstantRangeCount = info->push_constants.size();
-    layout_info.pPushConstantRanges = info->push_constants.data();
+static VkPipeline CreateGraphicsPipeline(Pipeline *pipeline, PipelineState *state) {
+    VkDevice device = VulkanDevice::handle;
 
-    VK_CHECK(vkCreatePipelineLayout(device, &layout_info, 0, &layout));
+    VkFormat color_formats[2] = { state->color_format, state->velocity_format };
+    u32 color_count = state->depth_only ? 0 : (state->velocity_format != VK_FORMAT_UNDEFINED ? 2 : 1);
 
     VkPipelineRenderingCreateInfo rendering_info = { VK_STRUCTURE_TYPE_PIPELINE_RENDERING_CREATE_INFO };
-    rendering_info.colorAttachmentCount = 1;
-    rendering_info.pColorAttachmentFormats = &swapchain->format;
-    rendering_info.depthAttachmentFormat = VK_FORMAT_D32_SFLOAT;
+    rendering_info.colorAttachmentCount = color_count;
+    rendering_info.pColorAttachmentFormats = color_formats;
+    rendering_info.depthAttachmentFormat = state->depth_format;
 
     array<VkDynamicState> dynamic_states = {
         VK_DYNAMIC_STATE_VIEWPORT,
-        VK_DYNAMIC_STATE_SCISSOR
+        VK_DYNAMIC_STATE_SCISSOR,
+        VK_DYNAMIC_STATE_CULL_MODE,
+        VK_DYNAMIC_STATE_FRONT_FACE,
+        VK_DYNAMIC_STATE_DEPTH_TEST_ENABLE,
+        VK_DYNAMIC_STATE_DEPTH_WRITE_ENABLE,
+        VK_DYNAMIC_STATE_DEPTH_COMPARE_OP
     };
 
+    if (state->depth_bias) {
+        dynamic_states.push_back(VK_DYNAMIC_STATE_DEPTH_BIAS);
+    }
+
     VkPipelineDynamicStateCreateInfo dynamic_state_info = { VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO };
     dynamic_state_info.dynamicStateCount = u32(dynamic_states.size());
     dynamic_state_info.pDynamicStates = dynamic_states.data();
@@ -102,25 +250,25 @@ void Pipeline::Create(VulkanSwapchain *swapchain, PipelineInfo *info) {
     viewport_info.scissorCount = 1;
 
     VkPipelineRasterizationStateCreateInfo rasterization_info = { VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO };
-    rasterization_info.polygonMode = VK_POLYGON_MODE_FILL;
-    rasterization_info.cullMode = VK_CULL_MODE_BACK_BIT;
-    rasterization_info.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterization_info.polygonMode = state->polygon_mode;
+    rasterization_info.depthBiasEnable = state->depth_bias;
     rasterization_info.lineWidth = 1.0f;
 
     // TODO: MSAA
     VkPipelineMultisampleStateCreateInfo multisample_info = { VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO };
-    multisample_info.rasterizationSamples = VulkanPhysicalDevice::msaa_samples;
+    multisample_info.rasterizationSamples = state->samples;
     multisample_info.minSampleShading = 1.0f;
     multisample_info.sampleShadingEnable = VK_TRUE;
 
     VkPipelineDepthStencilStateCreateInfo depth_stencil_info = { VK_STRUCTURE_TYPE_PIPELINE_DEPTH_STENCIL_STATE_CREATE_INFO };
-    depth_stencil_info.depthTestEnable = VK_TRUE;
-    depth_stencil_info.depthWriteEnable = VK_TRUE;
-    depth_stencil_info.depthCompareOp = VK_COMPARE_OP_LESS;
 
-    VkPipelineColorBlendAttachmentState color_blend_attachment = {};
-    color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
-    color_blend_attachment.blendEnable = VK_TRUE;
+    VkPipelineColorBlendAttachmentState color_blend_attachments[2] = {};
+    VkPipelineColorBlendAttachmentState &color_blend_attachment = color_blend_attachments[0];
+    if (state->color_write) {
+        color_blend_attachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT | VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+        color_blend_attachments[1].colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT;
+    }
+    color_blend_attachment.blendEnable = state->blend_enable;
     color_blend_attachment.srcColorBlendFactor = VK_BLEND_FACTOR_SRC_ALPHA;
     color_blend_attachment.dstColorBlendFactor = VK_BLEND_FACTOR_ONE_MINUS_SRC_ALPHA;
     color_blend_attachment.colorBlendOp = VK_BLEND_OP_ADD;
@@ -129,24 +277,23 @@ void Pipeline::Create(VulkanSwapchain *swapchain, PipelineInfo *info) {
     color_blend_attachment.alphaBlendOp = VK_BLEND_OP_ADD;
 
     VkPipelineColorBlendStateCreateInfo color_blend_info = { VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO };
-    color_blend_info.pAttachments = &color_blend_attachment;
-    color_blend_info.attachmentCount = 1;
+    color_blend_info.pAttachments = color_blend_attachments;
+    color_blend_info.attachmentCount = color_count;
 
-    array<VkPipelineShaderStageCreateInfo> shaders;
-
-    for (auto &&[stage, shader] : info->shaders) {
-        VkPipelineShaderStageCreateInfo stage_info = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
-        stage_info.stage = stage;
-        stage_info.module = shader->module;
-        stage_info.pName = "main";
+    array<VkSpecializationMapEntry> specialization_entries;
+    VkSpecializationInfo specialization_info = CreateSpecializationInfo(state, &specialization_entries);
 
-        shaders.push_back(stage_info);
+    array<VkPipelineShaderStageCreateInfo> stages = pipeline->stages;
+    if (!specialization_entries.empty()) {
+        for (VkPipelineShaderStageCreateInfo &stage : stages) {
+            stage.pSpecializationInfo = &specialization_info;
+        }
     }
 
     VkGraphicsPipelineCreateInfo pipeline_info = { VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO };
     pipeline_info.pNext = &rendering_info;
-    pipeline_info.stageCount = u32(shaders.size());
-    pipeline_info.pStages = shaders.data();
+    pipeline_info.stageCount = u32(stages.size());
+    pipeline_info.pStages = stages.data();
     pipeline_info.pVertexInputState = &vertex_input_info;
     pipeline_info.pInputAssemblyState = &input_assembly_info;
     pipeline_info.pViewportState = &viewport_info;
@@ -155,19 +302,251 @@ void Pipeline::Create(VulkanSwapchain *swapchain, PipelineInfo *info) {
     pipeline_info.pDepthStencilState = &depth_stencil_info;
     pipeline_info.pColorBlendState = &color_blend_info;
     pipeline_info.pDynamicState = &dynamic_state_info;
+    pipeline_info.layout = pipeline->layout;
+
+    VkPipeline handle;
+    VK_CHECK(vkCreateGraphicsPipelines(device, VulkanPipelineCache::handle, 1, &pipeline_info, 0, &handle));
+
+    return handle;
+}
+
+static void CreatePipelineLayout(Pipeline *pipeline, PipelineInfo *info) {
+    VkDevice device = VulkanDevice::handle;
+
+    VkDescriptorSetLayoutCreateInfo set_create_info = { VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO };
+    set_create_info.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_PUSH_DESCRIPTOR_BIT_KHR;
+    set_create_info.bindingCount = u32(info->set_bindings.size());
+    set_create_info.pBindings = info->set_bindings.data();
+
+    VK_CHECK(vkCreateDescriptorSetLayout(device, &set_create_info, 0, &pipeline->descriptor_set_layout));
+
+    VkPipelineLayoutCreateInfo layout_info = { VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO };
+    layout_info.setLayoutCount = 1;
+    layout_info.pSetLayouts = &pipeline->descriptor_set_layout;
+    layout_info.pushConstantRangeCount = info->push_constants.size();
+    layout_info.pPushConstantRanges = info->push_constants.data();
+
+    VK_CHECK(vkCreatePipelineLayout(device, &layout_info, 0, &pipeline->layout));
+
+    pipeline->stages.clear();
+    pipeline->stages_hash = HashBytes(&pipeline->layout, sizeof(pipeline->layout));
+
+    for (auto &&[stage, shader] : info->shaders) {
+        VkPipelineShaderStageCreateInfo stage_info = { VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO };
+        stage_info.stage = stage;
+        stage_info.module = shader->module;
+        stage_info.pName = "main";
+
+        pipeline->stages.push_back(stage_info);
+        pipeline->stages_hash = HashBytes(&stage_info.stage, sizeof(stage_info.stage), pipeline->stages_hash);
+        pipeline->stages_hash = HashBytes(&stage_info.module, sizeof(stage_info.module), pipeline->stages_hash);
+    }
+}
+
+void Pipeline::Create(VulkanSwapchain *swapchain, PipelineInfo *info) {
+    CreatePipelineLayout(this, info);
+
+    state = info->state;
+    if (!state.depth_only && state.color_format == VK_FORMAT_UNDEFINED) {
+        state.color_format = swapchain->format;
+        state.velocity_format = RENDER_VELOCITY_FORMAT;
+        state.samples = VulkanPhysicalDevice::msaa_samples;
+    }
+
+    f64 start = GetTime();
+
+    handle = CreateGraphicsPipeline(this, &state);
+    permutations[PipelineKey(this, &state)] = handle;
+
+    VulkanPipelineCache::creation_time += (GetTime() - start) * 1000;
+    VulkanPipelineCache::pipeline_count++;
+}
+
+void Pipeline::CreateCompute(PipelineInfo *info) {
+    VkDevice device = VulkanDevice::handle;
+
+    CreatePipelineLayout(this, info);
+    state = info->state;
+
+    array<VkSpecializationMapEntry> specialization_entries;
+    VkSpecializationInfo specialization_info = CreateSpecializationInfo(&state, &specialization_entries);
+
+    VkComputePipelineCreateInfo pipeline_info = { VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+    pipeline_info.stage = stages[0];
     pipeline_info.layout = layout;
 
-    VK_CHECK(vkCreateGraphicsPipelines(device, cache, 1, &pipeline_info, 0, &handle));
+    if (!specialization_entries.empty()) {
+        pipeline_info.stage.pSpecializationInfo = &specialization_info;
+    }
+
+    f64 start = GetTime();
+
+    VK_CHECK(vkCreateComputePipelines(device, VulkanPipelineCache::handle, 1, &pipeline_info, 0, &handle));
+    permutations[PipelineKey(this, &state)] = handle;
+
+    VulkanPipelineCache::creation_time += (GetTime() - start) * 1000;
+    VulkanPipelineCache::pipeline_count++;
 }
 
 void Pipeline::Destroy() {
     VkDevice device = VulkanDevice::handle;
 
-    vkDestroyPipeline(device, handle, 0);
+    // Jobs still reference this pipeline
+    if (!compiling.empty()) {
+        PipelineCompiler::Wait();
+        PipelineCompiler::Update();
+    }
+
+    for (auto &&[key, permutation] : permutations) {
+        vkDestroyPipeline(device, permutation, 0);
+    }
+    permutations.clear();
+
     vkDestroyPipelineLayout(device, layout, 0);
     vkDestroyDescriptorSetLayout(device, descriptor_set_layout, 0);
 }
 
+// Dynamic rendering needs the formats and sample count of the pipeline to match the bound attachments
+static bool SameAttachments(PipelineState *a, PipelineState *b) {
+    return a->color_format == b->color_format &&
+           a->velocity_format == b->velocity_format &&
+           a->depth_format == b->depth_format &&
+           a->samples == b->samples &&
+           a->depth_only == b->depth_only;
+}
+
+VkPipeline Pipeline::Get(PipelineState *state) {
+    u64 key = PipelineKey(this, state);
+
+    auto it = permutations.find(key);
+    if (it != permutations.end()) {
+        return it->second;
+    }
+
+    // The base pipeline can't stand in for other attachments, so those are compiled right away
+    if (!SameAttachments(state, &this->state)) {
+        f64 start = GetTime();
+
+        VkPipeline permutation = CreateGraphicsPipeline(this, state);
+        permutations[key] = permutation;
+
+        VulkanPipelineCache::creation_time += (GetTime() - start) * 1000;
+        VulkanPipelineCache::pipeline_count++;
+
+        return permutation;
+    }
+
+    if (compiling.find(key) == compiling.end()) {
+        compiling.insert(key);
+        PipelineCompiler::Submit({ this, *state, key, VK_NULL_HANDLE });
+    }
+
+    return handle;
+}
+
+u64 PipelineKey(Pipeline *pipeline, PipelineState *state) {
+    return HashBytes(state, sizeof(PipelineState), pipeline->stages_hash);
+}
+
+void PipelineState::Specialize(u32 constant_id, u32 value) {
+    assert(constant_id < PIPELINE_MAX_SPECIALIZATION);
+
+    specialization_mask |= 1 << constant_id;
+    specialization[constant_id] = value;
+}
+
+void DynamicState::Set(VkCommandBuffer cmd_buf) {
+    vkCmdSetCullMode(cmd_buf, cull_mode);
+    vkCmdSetFrontFace(cmd_buf, front_face);
+    vkCmdSetDepthTestEnable(cmd_buf, depth_test);
+    vkCmdSetDepthWriteEnable(cmd_buf, depth_write);
+    vkCmdSetDepthCompareOp(cmd_buf, depth_compare);
+}
+
+std::thread PipelineCompiler::worker;
+std::mutex PipelineCompiler::mutex;
+std::condition_variable PipelineCompiler::condition;
+queue<PipelineCompileJob> PipelineCompiler::jobs;
+array<PipelineCompileJob> PipelineCompiler::finished;
+bool PipelineCompiler::running = false;
+bool PipelineCompiler::busy = false;
+
+void PipelineCompiler::Create() {
+    running = true;
+    worker = std::thread(WorkerLoop);
+}
+
+void PipelineCompiler::Destroy() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    condition.notify_all();
+    worker.join();
+
+    // Pipelines destroy their own permutations, anything left here has no owner anymore
+    for (PipelineCompileJob &job : finished) {
+        vkDestroyPipeline(VulkanDevice::handle, job.result, 0);
+    }
+    finished.clear();
+}
+
+void PipelineCompiler::Submit(PipelineCompileJob job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push(job);
+    }
+    condition.notify_all();
+}
+
+void PipelineCompiler::Update() {
+    array<PipelineCompileJob> done;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        done.swap(finished);
+    }
+
+    for (PipelineCompileJob &job : done) {
+        job.pipeline->permutations[job.key] = job.result;
+        job.pipeline->compiling.erase(job.key);
+    }
+}
+
+void PipelineCompiler::Wait() {
+    std::unique_lock<std::mutex> lock(mutex);
+    condition.wait(lock, [] { return jobs.empty() && !busy; });
+}
+
+void PipelineCompiler::WorkerLoop() {
+    Profiler::SetThreadName("Pipeline compiler");
+
+    std::unique_lock<std::mutex> lock(mutex);
+
+    while (true) {
+        condition.wait(lock, [] { return !running || !jobs.empty(); });
+
+        if (!running) {
+            return;
+        }
+
+        PipelineCompileJob job = jobs.front();
+        jobs.pop();
+        busy = true;
+
+        // The pipeline cache is internally synchronized, so this can overlap with the main thread
+        lock.unlock();
+        {
+            PROFILE_SCOPE("Compile pipeline");
+            job.result = CreateGraphicsPipeline(job.pipeline, &job.state);
+        }
+        lock.lock();
+
+        finished.push_back(job);
+        busy = false;
+        condition.notify_all();
+    }
+}
+
 VkDescriptorUpdateTemplate CreateDescriptorUpdateTemplate(Pipeline *pipeline, PipelineInfo *info, VkPipelineBindPoint bind_point) {
     // Note: this assumes we we use every binding from 0 to n
     array<VkDescriptorUpdateTemplateEntry> entries(info->set_bindings.size());
@@ -8,31 +8,128 @@ struct Shader {
     void Destroy();
 };
 
-struct Vertex {
-    glm::vec<3, f32> position;
-    glm::vec<4, u8> normal;
-    glm::vec<2, f32> tex_coord;
+#define PIPELINE_MAX_SPECIALIZATION 8
+
+// Everything that needs its own VkPipeline. Cull mode, front face and the depth test
+// are dynamic state (see DynamicState), so changing them never needs a compile.
+struct PipelineState {
+    VkPolygonMode polygon_mode = VK_POLYGON_MODE_FILL;
+    VkBool32 blend_enable = VK_TRUE;
+    VkBool32 color_write = VK_TRUE;
+    // Undefined means the main pass: swapchain format and sample count plus the velocity target
+    VkFormat color_format = VK_FORMAT_UNDEFINED;
+    // Second color attachment, undefined for none
+    VkFormat velocity_format = VK_FORMAT_UNDEFINED;
+    VkFormat depth_format = VK_FORMAT_D32_SFLOAT;
+    VkSampleCountFlagBits samples = VK_SAMPLE_COUNT_1_BIT;
+    // No color attachment, for shadow and depth passes
+    VkBool32 depth_only = VK_FALSE;
+    // Bias values are dynamic, set with vkCmdSetDepthBias
+    VkBool32 depth_bias = VK_FALSE;
+
+    // Specialization constants for every stage, indexed by constant_id.
+    // Ids not in specialization_mask keep the default from the shader.
+    u32 specialization_mask = 0;
+    u32 specialization[PIPELINE_MAX_SPECIALIZATION] = {};
+
+    // Bools are passed as 0 or 1
+    void Specialize(u32 constant_id, u32 value);
+};
+
+struct DynamicState {
+    VkCullModeFlags cull_mode = VK_CULL_MODE_BACK_BIT;
+    VkFrontFace front_face = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    VkBool32 depth_test = VK_TRUE;
+    VkBool32 depth_write = VK_TRUE;
+    VkCompareOp depth_compare = VK_COMPARE_OP_LESS;
+
+    // Has to be called after every pipeline bind
+    void Set(VkCommandBuffer cmd_buf);
 };
 
 struct PipelineInfo {
     map<VkShaderStageFlagBits, Shader *> shaders;
     array<VkDescriptorSetLayoutBinding> set_bindings;
     array<VkPushConstantRange> push_constants;
+    PipelineState state;
     
     void AddShader(VkShaderStageFlagBits stage, Shader *shader);
     void AddBinding(VkShaderStageFlags stage, VkDescriptorType type);
     void AddPushConstant(VkShaderStageFlags stage, u32 size);
 };
 
+// Shared by every pipeline and kept on disk, so later runs don't compile from SPIR-V again.
+// A file from another device or driver version is ignored.
+struct VulkanPipelineCache {
+    static VkPipelineCache handle;
+    static string path;
+    static bool loaded;
+
+    // Time spent creating pipelines, reported by LogStats
+    static f64 creation_time;
+    static u32 pipeline_count;
+
+    static void Create(const char *path);
+    // Writes the cache back to disk
+    static void Destroy();
+
+    static void LogStats();
+};
+
 struct Pipeline {
+    // Built from PipelineInfo::state in Create, used while other permutations compile
     VkPipeline handle;
     VkPipelineLayout layout;
     VkDescriptorSetLayout descriptor_set_layout;
-    // TODO: cache
-    VkPipelineCache cache = 0;
+    PipelineState state;
+
+    // The shader modules have to outlive the pipeline, permutations are built from them later
+    array<VkPipelineShaderStageCreateInfo> stages;
+    u64 stages_hash;
+
+    // Keyed by PipelineKey, compiling holds the keys queued on the PipelineCompiler
+    map<u64, VkPipeline> permutations;
+    set<u64> compiling;
 
     void Create(VulkanSwapchain *swapchain, PipelineInfo *info);
+    // Compute pipelines have no permutations, bind handle directly
+    void CreateCompute(PipelineInfo *info);
     void Destroy();
+
+    // Returns handle until the permutation for state is ready. Only blocks when state renders to
+    // other attachments than handle, those permutations are compiled on the spot
+    VkPipeline Get(PipelineState *state);
+};
+
+u64 PipelineKey(Pipeline *pipeline, PipelineState *state);
+
+struct PipelineCompileJob {
+    Pipeline *pipeline;
+    PipelineState state;
+    u64 key;
+    VkPipeline result;
+};
+
+// Builds pipeline permutations on a background thread so new render states don't hitch a frame
+struct PipelineCompiler {
+    static std::thread worker;
+    static std::mutex mutex;
+    static std::condition_variable condition;
+    static queue<PipelineCompileJob> jobs;
+    static array<PipelineCompileJob> finished;
+    static bool running;
+    static bool busy;
+
+    static void Create();
+    static void Destroy();
+
+    static void Submit(PipelineCompileJob job);
+    // Hands finished permutations to their pipelines, call once per frame
+    static void Update();
+    // Blocks until every queued job is done
+    static void Wait();
+
+    static void WorkerLoop();
 };
 
 union DescriptorInfo {
@@ -45,6 +142,13 @@ union DescriptorInfo {
         image.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
     }
 
+    // Storage images pass a null sampler and VK_IMAGE_LAYOUT_GENERAL
+    DescriptorInfo(VkSampler sampler, VkImageView view, VkImageLayout layout=VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL) {
+        image.sampler = sampler;
+        image.imageView = view;
+        image.imageLayout = layout;
+    }
+
     DescriptorInfo(StorageBuffer *storage_buffer) {
         buffer.buffer = storage_buffer->buffer;
         buffer.offset = 0;
@@ -0,0 +1,370 @@
+#include "VulkanRenderer.h"
+
+array<GPUProfilerFrame> GPUProfiler::frames;
+u32 GPUProfiler::current_frame = 0;
+array<u32> GPUProfiler::scope_stack;
+array<GPUTiming> GPUProfiler::timings;
+u64 GPUProfiler::resolved_frames = 0;
+
+bool GPUPipelineStats::enabled = false;
+array<GPUStatsFrame> GPUPipelineStats::frames;
+u32 GPUPipelineStats::current_frame = 0;
+u32 GPUPipelineStats::active_pass = UINT32_MAX;
+array<GPUPassStats> GPUPipelineStats::passes;
+
+VkQueryPool GPUFrameTimer::query_pool = VK_NULL_HANDLE;
+array<bool> GPUFrameTimer::recorded;
+u32 GPUFrameTimer::current_frame = 0;
+f64 GPUFrameTimer::frame_time = 0;
+
+static void CreateQueryPool(GPUProfilerFrame *frame, u32 capacity) {
+    VkQueryPoolCreateInfo query_pool_info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_info.queryCount = capacity;
+
+    VK_CHECK(vkCreateQueryPool(VulkanDevice::handle, &query_pool_info, 0, &frame->query_pool));
+    frame->query_capacity = capacity;
+}
+
+void GPUProfiler::Create(u32 frame_count) {
+    frames.resize(frame_count);
+
+    for (GPUProfilerFrame &frame : frames) {
+        CreateQueryPool(&frame, GPU_PROFILER_INITIAL_QUERIES);
+    }
+}
+
+void GPUProfiler::Destroy() {
+    for (GPUProfilerFrame &frame : frames) {
+        vkDestroyQueryPool(VulkanDevice::handle, frame.query_pool, 0);
+    }
+
+    frames.clear();
+    timings.clear();
+}
+
+void GPUProfiler::BeginFrame(VkCommandBuffer cmd_buf, u32 frame_index) {
+    current_frame = frame_index;
+    GPUProfilerFrame *frame = &frames[frame_index];
+
+    if (frame->recorded) {
+        Resolve(frame);
+    }
+
+    if (frame->queries_dropped > 0) {
+        u32 capacity = frame->query_capacity;
+        while (capacity < frame->query_count + frame->queries_dropped) {
+            capacity *= 2;
+        }
+
+        vkDestroyQueryPool(VulkanDevice::handle, frame->query_pool, 0);
+        CreateQueryPool(frame, capacity);
+    }
+
+    frame->scopes.clear();
+    frame->query_count = 0;
+    frame->queries_dropped = 0;
+    frame->recorded = true;
+    scope_stack.clear();
+
+    vkCmdResetQueryPool(cmd_buf, frame->query_pool, 0, frame->query_capacity);
+}
+
+void GPUProfiler::Resolve(GPUProfilerFrame *frame) {
+    if (frame->query_count == 0) {
+        return;
+    }
+
+    array<u64> results(frame->query_count);
+
+    // No WAIT_BIT, if the results aren't there yet the old timings are kept
+    VkResult result = vkGetQueryPoolResults(
+        VulkanDevice::handle, frame->query_pool,
+        0, frame->query_count, results.size() * sizeof(u64), results.data(),
+        sizeof(u64), VK_QUERY_RESULT_64_BIT
+    );
+    if (result != VK_SUCCESS) {
+        return;
+    }
+
+    bool same_shape = timings.size() == frame->scopes.size();
+    for (u64 i = 0; same_shape && i < timings.size(); ++i) {
+        same_shape = timings[i].name == frame->scopes[i].name && timings[i].depth == frame->scopes[i].depth;
+    }
+
+    timings.resize(frame->scopes.size());
+
+    f64 timestamp_period = VulkanPhysicalDevice::properties.limits.timestampPeriod;
+
+    for (u64 i = 0; i < frame->scopes.size(); ++i) {
+        GPUScope *scope = &frame->scopes[i];
+        GPUTiming *timing = &timings[i];
+
+        u64 begin = results[scope->begin_query];
+        u64 end = results[scope->begin_query + 1];
+
+        timing->name = scope->name;
+        timing->depth = scope->depth;
+        timing->time = f64(end - begin) * timestamp_period * 1e-6;
+        timing->average = same_shape ? timing->average * 0.95 + timing->time * 0.05 : timing->time;
+    }
+
+    resolved_frames++;
+}
+
+void GPUProfiler::BeginScope(VkCommandBuffer cmd_buf, const char *name) {
+    GPUProfilerFrame *frame = &frames[current_frame];
+
+    if (frame->query_count + 2 > frame->query_capacity) {
+        frame->queries_dropped += 2;
+        scope_stack.push_back(UINT32_MAX);
+        return;
+    }
+
+    GPUScope scope;
+    scope.name = name;
+    scope.depth = u32(scope_stack.size());
+    scope.begin_query = frame->query_count;
+    frame->query_count += 2;
+
+    scope_stack.push_back(u32(frame->scopes.size()));
+    frame->scopes.push_back(scope);
+
+    vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, frame->query_pool, scope.begin_query);
+}
+
+void GPUProfiler::EndScope(VkCommandBuffer cmd_buf) {
+    assert(!scope_stack.empty());
+
+    GPUProfilerFrame *frame = &frames[current_frame];
+
+    u32 index = scope_stack.back();
+    scope_stack.pop_back();
+
+    if (index == UINT32_MAX) {
+        return;
+    }
+
+    vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, frame->query_pool, frame->scopes[index].begin_query + 1);
+}
+
+f64 GPUProfiler::GetFrameTime() {
+    return timings.empty() ? 0.0 : timings[0].time;
+}
+
+void GPUProfiler::Log() {
+    for (GPUTiming &timing : timings) {
+        LogInfo("%*s%s: %.3fms (avg %.3fms)", timing.depth * 2, "", timing.name, timing.time, timing.average);
+    }
+}
+
+void GPUProfiler::Dump(const char *file_path) {
+    FILE *file = fopen(file_path, "w");
+    if (!file) {
+        LogError("Failed to open %s for the GPU profile", file_path);
+        return;
+    }
+
+    for (GPUTiming &timing : timings) {
+        fprintf(file, "%*s%s: %.3fms (avg %.3fms)\n", timing.depth * 2, "", timing.name, timing.time, timing.average);
+    }
+
+    GPUPipelineStats::Dump(file);
+
+    fclose(file);
+    LogInfo("Wrote GPU profile to %s", file_path);
+}
+
+void GPUPipelineStats::Create(u32 frame_count) {
+    enabled = VulkanPhysicalDevice::features.pipelineStatisticsQuery;
+    if (!enabled) {
+        LogInfo("Pipeline statistics queries aren't supported");
+        return;
+    }
+
+    frames.resize(frame_count);
+
+    for (GPUStatsFrame &frame : frames) {
+        VkQueryPoolCreateInfo query_pool_info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+        query_pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+        query_pool_info.queryCount = GPU_STATS_MAX_PASSES;
+        // Has to match the order of GPUPassCounters
+        query_pool_info.pipelineStatistics =
+            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_VERTICES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT |
+            VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT;
+
+        VK_CHECK(vkCreateQueryPool(VulkanDevice::handle, &query_pool_info, 0, &frame.query_pool));
+    }
+}
+
+void GPUPipelineStats::Destroy() {
+    for (GPUStatsFrame &frame : frames) {
+        vkDestroyQueryPool(VulkanDevice::handle, frame.query_pool, 0);
+    }
+
+    frames.clear();
+    passes.clear();
+}
+
+void GPUPipelineStats::BeginFrame(VkCommandBuffer cmd_buf, u32 frame_index) {
+    if (!enabled) {
+        return;
+    }
+
+    current_frame = frame_index;
+    GPUStatsFrame *frame = &frames[frame_index];
+
+    if (frame->recorded) {
+        Resolve(frame);
+    }
+
+    frame->passes.clear();
+    frame->recorded = true;
+    active_pass = UINT32_MAX;
+
+    vkCmdResetQueryPool(cmd_buf, frame->query_pool, 0, GPU_STATS_MAX_PASSES);
+}
+
+void GPUPipelineStats::Resolve(GPUStatsFrame *frame) {
+    if (frame->passes.empty()) {
+        return;
+    }
+
+    array<GPUPassCounters> results(frame->passes.size());
+
+    VkResult result = vkGetQueryPoolResults(
+        VulkanDevice::handle, frame->query_pool,
+        0, u32(results.size()), results.size() * sizeof(GPUPassCounters), results.data(),
+        sizeof(GPUPassCounters), VK_QUERY_RESULT_64_BIT
+    );
+    if (result != VK_SUCCESS) {
+        return;
+    }
+
+    passes = frame->passes;
+    for (u64 i = 0; i < passes.size(); ++i) {
+        passes[i].counters = results[i];
+    }
+}
+
+void GPUPipelineStats::BeginPass(VkCommandBuffer cmd_buf, const char *name) {
+    assert(active_pass == UINT32_MAX);
+
+    if (!enabled) {
+        return;
+    }
+
+    GPUStatsFrame *frame = &frames[current_frame];
+    if (frame->passes.size() >= GPU_STATS_MAX_PASSES) {
+        return;
+    }
+
+    GPUPassStats pass = {};
+    pass.name = name;
+
+    active_pass = u32(frame->passes.size());
+    frame->passes.push_back(pass);
+
+    vkCmdBeginQuery(cmd_buf, frame->query_pool, active_pass, 0);
+}
+
+void GPUPipelineStats::EndPass(VkCommandBuffer cmd_buf) {
+    if (active_pass == UINT32_MAX) {
+        return;
+    }
+
+    vkCmdEndQuery(cmd_buf, frames[current_frame].query_pool, active_pass);
+    active_pass = UINT32_MAX;
+}
+
+void GPUPipelineStats::CountTriangles(u64 count) {
+    if (active_pass == UINT32_MAX) {
+        return;
+    }
+
+    frames[current_frame].passes[active_pass].submitted_triangles += count;
+}
+
+// Vertex shader invocations per submitted vertex, low when the post transform cache is hit often
+static f64 VertexReuse(GPUPassCounters *counters) {
+    return counters->input_vertices ? f64(counters->vertex_invocations) / f64(counters->input_vertices) : 0.0;
+}
+
+void GPUPipelineStats::Log() {
+    for (GPUPassStats &pass : passes) {
+        GPUPassCounters *counters = &pass.counters;
+
+        LogInfo(
+            "%s: %lu triangles submitted, %lu assembled, %lu after clipping, %lu vertex invocations (%.2f per vertex), %lu fragment invocations",
+            pass.name, pass.submitted_triangles, counters->input_primitives, counters->clipping_primitives,
+            counters->vertex_invocations, VertexReuse(counters), counters->fragment_invocations
+        );
+    }
+}
+
+void GPUPipelineStats::Dump(FILE *file) {
+    if (passes.empty()) {
+        return;
+    }
+
+    fprintf(file, "\npass,submitted_triangles,input_vertices,input_primitives,vertex_invocations,clipping_primitives,fragment_invocations\n");
+
+    for (GPUPassStats &pass : passes) {
+        GPUPassCounters *counters = &pass.counters;
+
+        fprintf(
+            file, "%s,%lu,%lu,%lu,%lu,%lu,%lu\n",
+            pass.name, pass.submitted_triangles, counters->input_vertices, counters->input_primitives,
+            counters->vertex_invocations, counters->clipping_primitives, counters->fragment_invocations
+        );
+    }
+}
+
+void GPUFrameTimer::Create(u32 frame_count) {
+    VkQueryPoolCreateInfo query_pool_info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+    query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    query_pool_info.queryCount = frame_count * 2;
+
+    VK_CHECK(vkCreateQueryPool(VulkanDevice::handle, &query_pool_info, 0, &query_pool));
+
+    recorded.assign(frame_count, false);
+    frame_time = 0;
+}
+
+void GPUFrameTimer::Destroy() {
+    vkDestroyQueryPool(VulkanDevice::handle, query_pool, 0);
+    query_pool = VK_NULL_HANDLE;
+
+    recorded.clear();
+}
+
+void GPUFrameTimer::Begin(VkCommandBuffer cmd_buf, u32 frame) {
+    current_frame = frame;
+
+    if (recorded[frame]) {
+        u64 results[2];
+
+        // No WAIT_BIT, if the results aren't there yet the old time is kept
+        VkResult result = vkGetQueryPoolResults(
+            VulkanDevice::handle, query_pool, frame * 2, 2,
+            sizeof(results), results, sizeof(u64), VK_QUERY_RESULT_64_BIT
+        );
+
+        if (result == VK_SUCCESS) {
+            f64 timestamp_period = VulkanPhysicalDevice::properties.limits.timestampPeriod;
+            frame_time = f64(results[1] - results[0]) * timestamp_period * 1e-6;
+        }
+    }
+
+    vkCmdResetQueryPool(cmd_buf, query_pool, frame * 2, 2);
+    vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, query_pool, frame * 2);
+
+    recorded[frame] = true;
+}
+
+void GPUFrameTimer::End(VkCommandBuffer cmd_buf) {
+    vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, query_pool, current_frame * 2 + 1);
+}
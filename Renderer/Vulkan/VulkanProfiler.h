@@ -0,0 +1,167 @@
+#ifndef VULKAN_PROFILER_H
+#define VULKAN_PROFILER_H
+
+// Queries per frame to start with, a frame that runs out grows its pool the next time around
+#define GPU_PROFILER_INITIAL_QUERIES 64
+
+// Passes with pipeline statistics per frame, later ones aren't counted
+#define GPU_STATS_MAX_PASSES 16
+
+struct GPUScope {
+    const char *name;
+    u32 depth;
+    // The end timestamp is the query right after
+    u32 begin_query;
+};
+
+struct GPUProfilerFrame {
+    VkQueryPool query_pool = VK_NULL_HANDLE;
+    u32 query_capacity = 0;
+    u32 query_count = 0;
+    // Queries that didn't fit into the pool, it's resized before it is used again
+    u32 queries_dropped = 0;
+    array<GPUScope> scopes;
+    bool recorded = false;
+};
+
+// One resolved scope. The tree is stored depth first, children follow their parent with a larger depth
+struct GPUTiming {
+    const char *name;
+    u32 depth;
+    f64 time;
+    // Reset whenever the tree changes shape
+    f64 average;
+};
+
+// Timestamp profiler for named nested scopes. Every frame in flight has its own query pool,
+// which is read back when that frame comes around again. Its fence has been waited on by
+// then, so reading never stalls and the timings lag frames_in_flight frames behind.
+struct GPUProfiler {
+    static array<GPUProfilerFrame> frames;
+    static u32 current_frame;
+    // Index into the current frame's scopes, UINT32_MAX for scopes that didn't fit
+    static array<u32> scope_stack;
+    static array<GPUTiming> timings;
+    // Incremented whenever new timings came in
+    static u64 resolved_frames;
+
+    static void Create(u32 frame_count);
+    static void Destroy();
+
+    // Reads back the last results of this frame's pool and resets it, call right after the command buffer began
+    static void BeginFrame(VkCommandBuffer cmd_buf, u32 frame);
+    static void Resolve(GPUProfilerFrame *frame);
+
+    static void BeginScope(VkCommandBuffer cmd_buf, const char *name);
+    static void EndScope(VkCommandBuffer cmd_buf);
+
+    // Time of the outermost scope, zero until the first results are in
+    static f64 GetFrameTime();
+
+    static void Log();
+    static void Dump(const char *file_path);
+};
+
+struct GPUScopeGuard {
+    VkCommandBuffer cmd_buf;
+
+    GPUScopeGuard(VkCommandBuffer cmd_buf, const char *name) : cmd_buf(cmd_buf) {
+        GPUProfiler::BeginScope(cmd_buf, name);
+    }
+
+    ~GPUScopeGuard() {
+        GPUProfiler::EndScope(cmd_buf);
+    }
+};
+
+// Counters of one pass, in the order vkGetQueryPoolResults returns them
+struct GPUPassCounters {
+    u64 input_vertices;
+    u64 input_primitives;
+    u64 vertex_invocations;
+    u64 clipping_primitives;
+    u64 fragment_invocations;
+};
+
+struct GPUPassStats {
+    const char *name;
+    // From the index counts on the CPU, the rest comes from the GPU
+    u64 submitted_triangles;
+    GPUPassCounters counters;
+};
+
+struct GPUStatsFrame {
+    VkQueryPool query_pool = VK_NULL_HANDLE;
+    array<GPUPassStats> passes;
+    bool recorded = false;
+};
+
+// Pipeline statistics queries per pass. Queries of the same type can't be active at the same time,
+// so unlike the timing scopes passes don't nest. Read back the same way as the GPUProfiler.
+struct GPUPipelineStats {
+    // Off when the device has no pipelineStatisticsQuery
+    static bool enabled;
+    static array<GPUStatsFrame> frames;
+    static u32 current_frame;
+    // Index into the current frame's passes, UINT32_MAX outside of a pass
+    static u32 active_pass;
+    static array<GPUPassStats> passes;
+
+    static void Create(u32 frame_count);
+    static void Destroy();
+
+    static void BeginFrame(VkCommandBuffer cmd_buf, u32 frame);
+    static void Resolve(GPUStatsFrame *frame);
+
+    // Has to end in the same render pass instance it began in, or both outside of one
+    static void BeginPass(VkCommandBuffer cmd_buf, const char *name);
+    static void EndPass(VkCommandBuffer cmd_buf);
+    static void CountTriangles(u64 count);
+
+    static void Log();
+    static void Dump(FILE *file);
+};
+
+struct GPUStatsGuard {
+    VkCommandBuffer cmd_buf;
+
+    GPUStatsGuard(VkCommandBuffer cmd_buf, const char *name) : cmd_buf(cmd_buf) {
+        GPUPipelineStats::BeginPass(cmd_buf, name);
+    }
+
+    ~GPUStatsGuard() {
+        GPUPipelineStats::EndPass(cmd_buf);
+    }
+};
+
+// Two timestamps around every frame, read back like the GPUProfiler. Unlike the scopes it is never
+// compiled out, dynamic resolution needs the GPU frame time in every build.
+struct GPUFrameTimer {
+    // Begin and end query for every frame in flight
+    static VkQueryPool query_pool;
+    static array<bool> recorded;
+    static u32 current_frame;
+    // Last resolved frame in milliseconds, zero until the first results are in
+    static f64 frame_time;
+
+    static void Create(u32 frame_count);
+    static void Destroy();
+
+    // Reads back this frame's last results and writes the begin timestamp, call right after the command buffer began
+    static void Begin(VkCommandBuffer cmd_buf, u32 frame);
+    static void End(VkCommandBuffer cmd_buf);
+};
+
+#define GPU_SCOPE_CONCAT_INNER(a, b) a##b
+#define GPU_SCOPE_CONCAT(a, b) GPU_SCOPE_CONCAT_INNER(a, b)
+
+// Times the rest of the enclosing block, name has to outlive the frame
+#ifndef VULKAN_RENDERER_DIST
+#define GPU_SCOPE(cmd_buf, name) GPUScopeGuard GPU_SCOPE_CONCAT(gpu_scope_, __LINE__)(cmd_buf, name)
+#define GPU_STATS(cmd_buf, name) GPUStatsGuard GPU_SCOPE_CONCAT(gpu_stats_, __LINE__)(cmd_buf, name)
+#else
+#define GPU_SCOPE(cmd_buf, name)
+#define GPU_STATS(cmd_buf, name)
+#endif
+
+#endif
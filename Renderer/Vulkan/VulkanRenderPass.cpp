@@ -17,6 +17,19 @@ void RenderPass::Create(VulkanSwapchain *swapchain) {
         render_finished_semaphores[i] = CreateSemaphore();
         in_flight_fences[i] = CreateFence(VK_FENCE_CREATE_SIGNALED_BIT);
     }
+
+    render_extent = swapchain->extent;
+
+    // Scaled frames are upscaled with a linear blit, without it only full resolution works
+    VkFormatProperties properties;
+    vkGetPhysicalDeviceFormatProperties(VulkanPhysicalDevice::handle, swapchain->format, &properties);
+
+    VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+    blit_supported = (properties.optimalTilingFeatures & required) == required;
+
+    if (!blit_supported) {
+        LogInfo("Swapchain format can't be blitted - Dynamic resolution disabled");
+    }
 }
 
 void RenderPass::Destroy() {
@@ -31,21 +44,37 @@ void RenderPass::Destroy() {
 }
 
 VkCommandBuffer RenderPass::BeginFrame(RenderImages *images) {
+    PROFILE_FUNCTION();
+
     swapchain->CheckResize(images);
 
     VK_CHECK(vkWaitForFences(VulkanDevice::handle, 1, &in_flight_fences[current_frame], VK_TRUE, UINT64_MAX));
 
-    VkResult result = vkAcquireNextImageKHR(
-        VulkanDevice::handle, swapchain->handle,
-        UINT64_MAX, image_available_semaphores[current_frame],
-        VK_NULL_HANDLE, &current_image
-    );
-    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
-        LogFatal("Failed to acquire swap chain image");
+    DeletionQueue::Collect(frames_in_flight);
+
+    if (swapchain->headless) {
+        current_image = current_frame;
+    } else {
+        VkResult result = vkAcquireNextImageKHR(
+            VulkanDevice::handle, swapchain->handle,
+            UINT64_MAX, image_available_semaphores[current_frame],
+            VK_NULL_HANDLE, &current_image
+        );
+        if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+            LogFatal("Failed to acquire swap chain image");
+        }
     }
     
     VK_CHECK(vkResetFences(VulkanDevice::handle, 1, &in_flight_fences[current_frame]));
 
+    f32 scale = blit_supported ? render_scale : 1.0f;
+
+    // Multiples of 8 keep the extent from changing on every tiny scale adjustment
+    render_extent.width = (u32(f32(swapchain->extent.width) * scale) + 7) & ~7u;
+    render_extent.height = (u32(f32(swapchain->extent.height) * scale) + 7) & ~7u;
+    render_extent.width = render_extent.width < swapchain->extent.width ? render_extent.width : swapchain->extent.width;
+    render_extent.height = render_extent.height < swapchain->extent.height ? render_extent.height : swapchain->extent.height;
+
     graphics_command_buffers.Reset(current_frame);
     graphics_command_buffers.Begin(current_frame, VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
@@ -53,16 +82,28 @@ VkCommandBuffer RenderPass::BeginFrame(RenderImages *images) {
 }
 
 void RenderPass::EndFrame() {
+    PROFILE_FUNCTION();
+
     graphics_command_buffers.End(current_frame);
 
     VkPipelineStageFlags submit_stage_mask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
 
     VkSubmitInfo submit_info = { VK_STRUCTURE_TYPE_SUBMIT_INFO };
+    submit_info.commandBufferCount = 1;
+    submit_info.pCommandBuffers = &graphics_command_buffers.buffers[current_frame];
+
+    // Nothing was acquired and nothing is presented
+    if (swapchain->headless) {
+        VK_CHECK(vkQueueSubmit(VulkanDevice::graphics_queue, 1, &submit_info, in_flight_fences[current_frame]));
+
+        current_frame = (current_frame + 1) % frames_in_flight;
+        DeletionQueue::EndFrame();
+        return;
+    }
+
     submit_info.waitSemaphoreCount = 1;
     submit_info.pWaitSemaphores = &image_available_semaphores[current_frame];
     submit_info.pWaitDstStageMask = &submit_stage_mask;
-    submit_info.commandBufferCount = 1;
-    submit_info.pCommandBuffers = &graphics_command_buffers.buffers[current_frame];
     submit_info.signalSemaphoreCount = 1;
     submit_info.pSignalSemaphores = &render_finished_semaphores[current_frame];
 
@@ -81,6 +122,7 @@ void RenderPass::EndFrame() {
     }
 
     current_frame = (current_frame + 1) % frames_in_flight;
+    DeletionQueue::EndFrame();
 }
 
 void RenderPass::Begin(RenderImages *images) {
@@ -93,6 +135,15 @@ void RenderPass::Begin(RenderImages *images) {
     color_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
     color_attachment.clearValue.color = { 0.0f, 0.0f, 0.0f, 1.0f };
 
+    VkRenderingAttachmentInfo velocity_attachment = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
+    velocity_attachment.imageView = images->velocity_image.view;
+    velocity_attachment.imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL;
+    velocity_attachment.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR;
+    velocity_attachment.storeOp = VK_ATTACHMENT_STORE_OP_STORE;
+    velocity_attachment.clearValue.color = { 0.0f, 0.0f, 0.0f, 0.0f };
+
+    VkRenderingAttachmentInfo color_attachments[2] = { color_attachment, velocity_attachment };
+
     VkRenderingAttachmentInfo depth_attachment = { VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO };
     depth_attachment.imageView = images->depth_image.view;
     depth_attachment.imageLayout = VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL;
@@ -101,16 +152,19 @@ void RenderPass::Begin(RenderImages *images) {
     depth_attachment.clearValue.depthStencil = { 1.0f, 0 };
 
     VkRenderingInfo rendering_info = { VK_STRUCTURE_TYPE_RENDERING_INFO };
-    rendering_info.renderArea.extent = swapchain->extent;
+    rendering_info.renderArea.extent = render_extent;
     rendering_info.layerCount = 1;
-    rendering_info.colorAttachmentCount = 1;
-    rendering_info.pColorAttachments = &color_attachment;
+    rendering_info.colorAttachmentCount = ARRAY_SIZE(color_attachments);
+    rendering_info.pColorAttachments = color_attachments;
     rendering_info.pDepthAttachment = &depth_attachment;
 
-    VkImageMemoryBarrier barriers[2] = {
+    VkImageMemoryBarrier barriers[3] = {
         CreateBarrier(
             images->color_image.handle, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
         ),
+        CreateBarrier(
+            images->velocity_image.handle, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
+        ),
         CreateBarrier(
             images->depth_image.handle, 0, 0, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT
         )
@@ -124,8 +178,8 @@ void RenderPass::Begin(RenderImages *images) {
 
     vkCmdBeginRendering(graphics_command_buffer, &rendering_info);
 
-    VkViewport viewport = { 0.0f, 0.0f, f32(swapchain->extent.width), f32(swapchain->extent.height), 0.0f, 1.0f };
-    VkRect2D scissor = { { 0, 0 }, swapchain->extent };
+    VkViewport viewport = { 0.0f, 0.0f, f32(render_extent.width), f32(render_extent.height), 0.0f, 1.0f };
+    VkRect2D scissor = { { 0, 0 }, render_extent };
 
     vkCmdSetViewport(graphics_command_buffer, 0, 1, &viewport);
     vkCmdSetScissor(graphics_command_buffer, 0, 1, &scissor);
@@ -134,45 +188,84 @@ void RenderPass::Begin(RenderImages *images) {
 void RenderPass::End(RenderImages *images) {
     VkCommandBuffer graphics_command_buffer = graphics_command_buffers.buffers[current_frame];
 
-    vkCmdEndRendering(graphics_command_buffer);
+    EndRendering();
 
-    VkImageMemoryBarrier barriers[2] = {
-        CreateBarrier(
-            images->color_image.handle,
-            VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
-            VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
-        ),
-        CreateBarrier(
-            swapchain->images[current_image],
-            0, VK_ACCESS_TRANSFER_WRITE_BIT,
-            VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
-        )
-    };
+    VkImageMemoryBarrier barrier = CreateBarrier(
+        images->color_image.handle,
+        VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT, VK_ACCESS_TRANSFER_READ_BIT,
+        VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
+    );
 
     vkCmdPipelineBarrier(
         graphics_command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
         VK_PIPELINE_STAGE_TRANSFER_BIT, VK_DEPENDENCY_BY_REGION_BIT,
-        0, 0, 0, 0, ARRAY_SIZE(barriers), barriers
+        0, 0, 0, 0, 1, &barrier
+    );
+
+    Present(&images->color_image, render_extent);
+}
+
+void RenderPass::EndRendering() {
+    vkCmdEndRendering(graphics_command_buffers.buffers[current_frame]);
+}
+
+void RenderPass::Present(Image *image, VkExtent2D extent) {
+    VkCommandBuffer graphics_command_buffer = graphics_command_buffers.buffers[current_frame];
+
+    // Waits on the acquire semaphore, which only blocks the color attachment output stage
+    VkImageMemoryBarrier barrier = CreateBarrier(
+        swapchain->images[current_image],
+        0, VK_ACCESS_TRANSFER_WRITE_BIT,
+        VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_ASPECT_COLOR_BIT
     );
 
-    VkImageCopy copy_region = {};
-    copy_region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    copy_region.srcSubresource.layerCount = 1;
-    copy_region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-    copy_region.dstSubresource.layerCount = 1;
-    copy_region.extent = { swapchain->extent.width, swapchain->extent.height, 1 };
-
-    vkCmdCopyImage(
-        graphics_command_buffer,
-        images->color_image.handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
-        swapchain->images[current_image], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-        1, &copy_region
+    vkCmdPipelineBarrier(
+        graphics_command_buffer, VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+        VK_PIPELINE_STAGE_TRANSFER_BIT, VK_DEPENDENCY_BY_REGION_BIT,
+        0, 0, 0, 0, 1, &barrier
     );
 
+    // Copies need the same size and a compatible format, anything else is blitted
+    bool scaled = extent.width != swapchain->extent.width || extent.height != swapchain->extent.height;
+
+    if (scaled || image->format != swapchain->format) {
+        VkImageBlit blit_region = {};
+        blit_region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit_region.srcSubresource.layerCount = 1;
+        blit_region.srcOffsets[1] = { s32(extent.width), s32(extent.height), 1 };
+        blit_region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        blit_region.dstSubresource.layerCount = 1;
+        blit_region.dstOffsets[1] = { s32(swapchain->extent.width), s32(swapchain->extent.height), 1 };
+
+        vkCmdBlitImage(
+            graphics_command_buffer,
+            image->handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            swapchain->images[current_image], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &blit_region, VK_FILTER_LINEAR
+        );
+    } else {
+        VkImageCopy copy_region = {};
+        copy_region.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy_region.srcSubresource.layerCount = 1;
+        copy_region.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        copy_region.dstSubresource.layerCount = 1;
+        copy_region.extent = { swapchain->extent.width, swapchain->extent.height, 1 };
+
+        vkCmdCopyImage(
+            graphics_command_buffer,
+            image->handle, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL,
+            swapchain->images[current_image], VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            1, &copy_region
+        );
+    }
+
+    // Headless frames stay readable for copies back to the host
+    VkImageLayout final_layout = swapchain->headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+
     VkImageMemoryBarrier copy_barrier = CreateBarrier(
         swapchain->images[current_image],
         VK_ACCESS_TRANSFER_WRITE_BIT, 0,
-        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_PRESENT_SRC_KHR, VK_IMAGE_ASPECT_COLOR_BIT
+        VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, final_layout, VK_IMAGE_ASPECT_COLOR_BIT
     );
 
     vkCmdPipelineBarrier(
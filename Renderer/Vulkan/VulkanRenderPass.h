@@ -15,6 +15,15 @@ struct RenderPass {
     // need this because current_image is overwritten by vkAcquireNextImageKHR
     u32 current_frame = 0;
 
+    // The scene is rendered into the top left render_extent of the render images,
+    // which are always swapchain sized, and scaled up in End
+    f32 render_scale = 1.0f;
+    VkExtent2D render_extent;
+    bool blit_supported;
+    // Sub-pixel offset in NDC added to the projection's third column, only set for temporal upsampling.
+    // With glm's right handed projections the image moves by minus this.
+    glm::vec2 jitter = glm::vec2(0.0f);
+
     void Create(VulkanSwapchain *swapchain);
     void Destroy();
 
@@ -22,7 +31,12 @@ struct RenderPass {
     void EndFrame();
 
     void Begin(RenderImages *images);
+    // Ends rendering and presents the color image
     void End(RenderImages *images);
+
+    void EndRendering();
+    // Copies or upscales the top left extent of image to the swapchain, image has to be in TRANSFER_SRC_OPTIMAL
+    void Present(Image *image, VkExtent2D extent);
 };
 
 #endif
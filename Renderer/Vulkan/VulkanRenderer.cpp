@@ -38,57 +38,55 @@ void DestroyFence(VkFence handle) {
     vkDestroyFence(VulkanDevice::handle, handle, 0);
 }
 
-VkQueryPool RenderStats::query_pool = VK_NULL_HANDLE;
 f64 RenderStats::mspf_cpu = 0;
 f64 RenderStats::mspf_gpu = 0;
+f64 RenderStats::gpu_frame_time = 0;
 u64 RenderStats::draw_calls = 0;
 u64 RenderStats::triangles = 0;
 f64 RenderStats::cpu_frame_time_begin = 0;
+FrameTimeStats RenderStats::cpu_frame_times;
+FrameTimeStats RenderStats::gpu_frame_times;
+u64 RenderStats::gpu_resolved_frames = 0;
 
 #ifndef VULKAN_RENDERER_DIST
-void RenderStats::Create() {
-    VkQueryPoolCreateInfo query_pool_info = { VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
-    query_pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
-    query_pool_info.queryCount = 2;
-
-    VK_CHECK(vkCreateQueryPool(VulkanDevice::handle, &query_pool_info, 0, &query_pool));
+void RenderStats::Create(u32 frames_in_flight) {
+    GPUProfiler::Create(frames_in_flight);
+    GPUPipelineStats::Create(frames_in_flight);
 }
 
 void RenderStats::Destroy() {
-    vkDestroyQueryPool(VulkanDevice::handle, query_pool, 0);
+    GPUProfiler::Destroy();
+    GPUPipelineStats::Destroy();
 }
 
-void RenderStats::Begin(VkCommandBuffer cmd_buf) {
+void RenderStats::Begin(VkCommandBuffer cmd_buf, u32 frame) {
     draw_calls = 0;
     triangles = 0;
-    cpu_frame_time_begin = glfwGetTime() * 1000;
+    cpu_frame_time_begin = GetTime() * 1000;
 
-    vkCmdResetQueryPool(cmd_buf, query_pool, 0, 2);
-    vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, query_pool, 0);
+    GPUProfiler::BeginFrame(cmd_buf, frame);
+    GPUPipelineStats::BeginFrame(cmd_buf, frame);
+    GPUProfiler::BeginScope(cmd_buf, "Frame");
 }
 
 void RenderStats::EndGPU(VkCommandBuffer cmd_buf) {
-    vkCmdWriteTimestamp(cmd_buf, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT, query_pool, 1);
+    GPUProfiler::EndScope(cmd_buf);
 }
 
 void RenderStats::EndCPU() {
-    f64 cpu_frame_time_end = glfwGetTime() * 1000;
+    f64 cpu_frame_time_end = GetTime() * 1000;
     f64 cpu_frame_time_delta = cpu_frame_time_end - cpu_frame_time_begin;
     mspf_cpu = mspf_cpu * 0.95 + cpu_frame_time_delta * 0.05;
+    cpu_frame_times.Add(cpu_frame_time_delta);
 
-    u64 query_results[2];
-    
-    VK_CHECK(vkGetQueryPoolResults(
-        VulkanDevice::handle, query_pool,
-        0, 2, sizeof(query_results), query_results,
-        sizeof(query_results[0]), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT
-    ));
+    gpu_frame_time = GPUProfiler::GetFrameTime();
+    mspf_gpu = mspf_gpu * 0.95 + gpu_frame_time * 0.05;
 
-    f64 timestamp_period = VulkanPhysicalDevice::properties.limits.timestampPeriod;
-    f64 gpu_frame_time_begin = f64(query_results[0]) * timestamp_period * 1e-6;
-    f64 gpu_frame_time_end = f64(query_results[1]) * timestamp_period * 1e-6;
-    f64 gpu_frame_time_delta = gpu_frame_time_end - gpu_frame_time_begin;
-    mspf_gpu = mspf_gpu * 0.95 + gpu_frame_time_delta * 0.05;
+    // Frames whose timestamps weren't ready yet would count the previous time twice
+    if (GPUProfiler::resolved_frames != gpu_resolved_frames) {
+        gpu_resolved_frames = GPUProfiler::resolved_frames;
+        gpu_frame_times.Add(gpu_frame_time);
+    }
 }
 
 void RenderStats::DrawCall() {
@@ -97,20 +95,104 @@ void RenderStats::DrawCall() {
 
 void RenderStats::CountTriangles(u64 count) {
     triangles += count;
+    GPUPipelineStats::CountTriangles(count);
 }
 
-void RenderStats::SetTitle(GLFWwindow *window) {
-    char title[256];
-    sprintf(title, "cpu: %.2fms, gpu: %.2fms, render calls: %lu, triangles: %lu", mspf_cpu, mspf_gpu, draw_calls, triangles);
+void RenderStats::SetTitle(GLFWwindow *window, bool show_passes) {
+    char title[1024];
+    s32 length = snprintf(title, sizeof(title), "cpu: %.2fms, gpu: %.2fms, render calls: %lu, triangles: %lu", mspf_cpu, mspf_gpu, draw_calls, triangles);
+
+    u64 memory_usage;
+    u64 memory_budget;
+    GetVulkanMemoryBudget(&memory_usage, &memory_budget);
+    length += snprintf(title + length, sizeof(title) - length, ", vram: %lu/%luMB", memory_usage >> 20, memory_budget >> 20);
+
+    if (show_passes) {
+        for (GPUTiming &timing : GPUProfiler::timings) {
+            if (timing.depth == 1 && length < s32(sizeof(title))) {
+                length += snprintf(title + length, sizeof(title) - length, " | %s: %.2fms", timing.name, timing.average);
+            }
+        }
+    }
+
     glfwSetWindowTitle(window, title);
 }
+
+static void WriteSummary(FILE *file, const char *name, FrameTimeStats *stats, bool last) {
+    FrameTimeSummary summary = stats->Summarize();
+
+    fprintf(
+        file,
+        "    \"%s\": { \"frames\": %lu, \"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"p99.9\": %.4f, \"max\": %.4f, "
+        "\"hitch_threshold\": %.2f, \"hitches\": %lu }%s\n",
+        name, summary.frames, summary.mean, summary.p50, summary.p95, summary.p99, summary.p999, summary.max,
+        stats->hitch_threshold, summary.hitches, last ? "" : ","
+    );
+}
+
+void RenderStats::ExportFrameTimes(const char *path) {
+    string json_path = string(path) + ".json";
+    string csv_path = string(path) + ".csv";
+
+    FILE *file = fopen(json_path.c_str(), "w");
+    if (!file) {
+        LogError("Failed to open %s for the frame times", json_path.c_str());
+        return;
+    }
+
+    fprintf(file, "{\n");
+    WriteSummary(file, "cpu_ms", &cpu_frame_times, false);
+    WriteSummary(file, "gpu_ms", &gpu_frame_times, true);
+    fprintf(file, "}\n");
+    fclose(file);
+
+    file = fopen(csv_path.c_str(), "w");
+    if (!file) {
+        LogError("Failed to open %s for the frame times", csv_path.c_str());
+        return;
+    }
+
+    // GPU times lag behind and skip frames that weren't ready, so both are listed oldest first on their own
+    u64 cpu_count = cpu_frame_times.GetRecentCount();
+    u64 gpu_count = gpu_frame_times.GetRecentCount();
+    u64 rows = cpu_count > gpu_count ? cpu_count : gpu_count;
+
+    fprintf(file, "index,cpu_ms,gpu_ms\n");
+    for (u64 i = 0; i < rows; ++i) {
+        fprintf(file, "%lu,", i);
+
+        if (i < cpu_count) fprintf(file, "%.4f", cpu_frame_times.GetRecent(cpu_count - 1 - i));
+        fprintf(file, ",");
+        if (i < gpu_count) fprintf(file, "%.4f", gpu_frame_times.GetRecent(gpu_count - 1 - i));
+        fprintf(file, "\n");
+    }
+
+    fclose(file);
+
+    LogInfo("Wrote frame times to %s and %s", json_path.c_str(), csv_path.c_str());
+}
+
+void RenderStats::LogFrameTimes() {
+    FrameTimeStats *stats[2] = { &cpu_frame_times, &gpu_frame_times };
+    const char *names[2] = { "cpu", "gpu" };
+
+    for (u32 i = 0; i < 2; ++i) {
+        FrameTimeSummary summary = stats[i]->Summarize();
+        LogInfo(
+            "%s: p50 %.2fms, p95 %.2fms, p99 %.2fms, p99.9 %.2fms, max %.2fms, %lu hitches over %.1fms in %lu frames",
+            names[i], summary.p50, summary.p95, summary.p99, summary.p999, summary.max, summary.hitches, stats[i]->hitch_threshold, summary.frames
+        );
+    }
+}
 #else
-void RenderStats::Create() {}
+void RenderStats::Create(u32 frames_in_flight) {}
 void RenderStats::Destroy() {}
-void RenderStats::Begin(VkCommandBuffer cmd_buf);
-void RenderStats::EndGPU(VkCommandBuffer cmd_buf);
-void RenderStats::EndCPU(VkCommandBuffer cmd_buf);
+void RenderStats::Begin(VkCommandBuffer cmd_buf, u32 frame) {}
+void RenderStats::EndGPU(VkCommandBuffer cmd_buf) {}
+void RenderStats::EndCPU() {}
 void RenderStats::DrawCall() {}
 void RenderStats::CountTriangles(u64 count) {}
-void RenderStats::SetTitle(GLFWwindow *window) {}
+void RenderStats::SetTitle(GLFWwindow *window, bool show_passes) {}
+void RenderStats::ExportFrameTimes(const char *path) {}
+void RenderStats::LogFrameTimes() {}
 #endif
@@ -4,6 +4,10 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
 #include <vulkan/vulkan.h>
 #include <GLFW/glfw3.h>
 
@@ -13,6 +17,8 @@
 #include <glm/glm.hpp>
 
 #include "Common.h"
+#include "Core/FrameStats.h"
+#include "Core/Profiler.h"
 
 #define VK_CHECK(call) \
     if (call != VK_SUCCESS) { \
@@ -23,10 +29,12 @@
 #include "VulkanDevice.h"
 #include "VulkanAllocator.h"
 #include "VulkanBuffer.h"
+#include "VulkanDeletionQueue.h"
 #include "VulkanSwapchain.h"
 #include "VulkanCommandBuffer.h"
 #include "VulkanRenderPass.h"
 #include "VulkanPipeline.h"
+#include "VulkanProfiler.h"
 
 u32 FindMemoryType(u32 type_bits, VkMemoryPropertyFlags flags);
 
@@ -36,26 +44,39 @@ void DestroySemaphore(VkSemaphore handle);
 VkFence CreateFence(VkFenceCreateFlags flags=0); 
 void DestroyFence(VkFence handle);
 
+// GPU times come from the GPUProfiler's outermost scope and lag a few frames behind
 struct RenderStats {
-    static VkQueryPool query_pool;
 	static f64 mspf_cpu;
     static f64 mspf_gpu;
+    // Last frame only, mspf_gpu is averaged
+    static f64 gpu_frame_time;
     static u64 draw_calls;
     static u64 triangles;
 
     static f64 cpu_frame_time_begin;
 
-    static void Create();
+    // Every frame time, for percentiles and hitches the averages above hide
+    static FrameTimeStats cpu_frame_times;
+    static FrameTimeStats gpu_frame_times;
+    static u64 gpu_resolved_frames;
+
+    static void Create(u32 frames_in_flight);
     static void Destroy();
 
-    static void Begin(VkCommandBuffer cmd_buf);
+    static void Begin(VkCommandBuffer cmd_buf, u32 frame);
     static void EndGPU(VkCommandBuffer cmd_buf);
     static void EndCPU();
 
     static void DrawCall();
+    // Every indexed draw adds index_count / 3, for all passes
     static void CountTriangles(u64 count);
 
-    static void SetTitle(GLFWwindow *window);
+    // Adds the top level GPU passes when show_passes is set
+    static void SetTitle(GLFWwindow *window, bool show_passes=false);
+
+    // Writes path.json with the percentiles and hitches and path.csv with the most recent frames
+    static void ExportFrameTimes(const char *path);
+    static void LogFrameTimes();
 };
 
 #endif
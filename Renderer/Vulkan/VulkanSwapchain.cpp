@@ -43,7 +43,7 @@ VkPresentModeKHR VulkanSwapchain::ChooseSwapPresentMode(bool vsync) {
     return mode;
 }
 
-void VulkanSwapchain::Create(bool vsync) {
+void VulkanSwapchain::Create(bool vsync, VkSwapchainKHR old_swapchain) {
     this->vsync = vsync;
 
     VkSurfaceCapabilitiesKHR capabilities;
@@ -68,6 +68,7 @@ void VulkanSwapchain::Create(bool vsync) {
     swap_chain_info.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
     swap_chain_info.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     swap_chain_info.presentMode = ChooseSwapPresentMode(vsync);
+    swap_chain_info.oldSwapchain = old_swapchain;
 
     if (VulkanDevice::graphics_index == VulkanDevice::present_index) {
         swap_chain_info.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
@@ -103,9 +104,38 @@ void VulkanSwapchain::Create(bool vsync) {
     }
 }
 
+void VulkanSwapchain::CreateHeadless(VkExtent2D extent, u32 image_count) {
+    this->extent = extent;
+    headless = true;
+    vsync = false;
+    handle = VK_NULL_HANDLE;
+    format = VK_FORMAT_B8G8R8A8_UNORM;
+
+    offscreen_images.resize(image_count);
+    images.resize(image_count);
+    views.resize(image_count);
+
+    for (u32 i = 0; i < image_count; ++i) {
+        offscreen_images[i].Create(
+            format, extent.width, extent.height, 1, VK_SAMPLE_COUNT_1_BIT,
+            VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT
+        );
+
+        images[i] = offscreen_images[i].handle;
+        views[i] = offscreen_images[i].view;
+    }
+}
+
 void VulkanSwapchain::Destroy() {
     VkDevice device = VulkanDevice::handle;
 
+    if (headless) {
+        for (Image &image : offscreen_images) {
+            image.Destroy();
+        }
+        return;
+    }
+
     for (VkImageView view : views) {
         vkDestroyImageView(device, view, 0);
     }
@@ -114,6 +144,13 @@ void VulkanSwapchain::Destroy() {
 }
 
 void VulkanSwapchain::CheckResize(RenderImages *images) {
+    if (headless) {
+        if (!images->color_image.handle) {
+            images->Create(this);
+        }
+        return;
+    }
+
     VkSurfaceCapabilitiesKHR capabilities;
     VK_CHECK(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(VulkanPhysicalDevice::handle, VulkanInstance::surface, &capabilities));
 
@@ -122,13 +159,18 @@ void VulkanSwapchain::CheckResize(RenderImages *images) {
     }
 
     if (capabilities.currentExtent.width != extent.width || capabilities.currentExtent.height != extent.height) {
-        Destroy();
-        Create(vsync);
-        images->Destroy();
+        // Frames in flight may still render to or present the old images, so they're only released
+        for (VkImageView view : views) {
+            DeletionQueue::ReleaseView(view);
+        }
+
+        VkSwapchainKHR old_handle = handle;
+        Create(vsync, old_handle);
+        DeletionQueue::ReleaseSwapchain(old_handle);
+
+        images->Release();
         images->Create(this);
 
         extent = capabilities.currentExtent;
-
-        VK_CHECK(vkDeviceWaitIdle(VulkanDevice::handle));
     }
 }
@@ -8,11 +8,16 @@ struct VulkanSwapchain {
     array<VkImage> images;
     array<VkImageView> views;
     bool vsync;
+    // Without a surface the swapchain images are plain images owned here, nothing is presented
+    bool headless = false;
+    array<Image> offscreen_images;
     
     VkSurfaceFormatKHR ChooseFormat();
     VkPresentModeKHR ChooseSwapPresentMode(bool vsync); 
 
-    void Create(bool vsync);
+    // old_swapchain is retired, it still has to be destroyed
+    void Create(bool vsync, VkSwapchainKHR old_swapchain=VK_NULL_HANDLE);
+    void CreateHeadless(VkExtent2D extent, u32 image_count);
     void Destroy();
 
     void CheckResize(RenderImages *images);
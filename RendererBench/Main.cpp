@@ -0,0 +1,772 @@
+#include "Common.h"
+
+#include "Vulkan/VulkanRenderer.h"
+#include "Graphics/Model.h"
+#include "Graphics/MasterRenderer.h"
+#include "Graphics/SceneRenderer.h"
+
+#include <math.h>
+#include <algorithm>
+#include <filesystem>
+
+#include <glm/ext/matrix_clip_space.hpp>
+#include <glm/ext/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+// Procedurally generated stress scenes rendered headless along a fixed camera path.
+// Writes CPU and GPU frame time statistics as JSON, so runs with different
+// parameters can be plotted into scaling curves.
+//
+// With --regress dir it renders the reference scenes instead and compares them
+// against the baselines in dir, exiting with 1 on a regression. Scenes without
+// a baseline fail too, unless --allow-missing-baseline is given.
+
+#define BENCH_WIDTH       1280
+#define BENCH_HEIGHT      720
+#define BENCH_IMAGES      3
+// Distance between neighbouring instances on the grid
+#define BENCH_SPACING     3.0f
+
+// The final frame is box filtered down by this much before it is compared,
+// the thumbnails are small enough to check in next to the baselines
+#define BENCH_THUMBNAIL_SCALE 8
+
+struct BenchConfig {
+    u32 meshes = 16;
+    u32 instances = 64;
+    u32 triangles = 2000;
+    u32 lights = 64;
+    u32 materials = 8;
+    u32 frames = 600;
+    // Not measured, lets pipelines, shadows and dynamic state settle
+    u32 warmup = 60;
+    u32 seed = 1;
+    const char *output = "bench_results.json";
+    bool software = false;
+
+    // Regression runs
+    const char *baseline_dir = 0;
+    bool update_baselines = false;
+    // Skips scenes without a baseline instead of failing, for adding new scenes
+    bool allow_missing_baseline = false;
+    // Allowed slowdown or growth in percent
+    f64 tolerance = 10.0;
+    // Below this the final frame counts as changed
+    f64 min_psnr = 40.0;
+};
+
+// Kept small enough for software rasterizers, the numbers only have to be comparable between runs
+struct ReferenceScene {
+    const char *name;
+    u32 meshes;
+    u32 instances;
+    u32 triangles;
+    u32 lights;
+    u32 materials;
+};
+
+static ReferenceScene reference_scenes[] = {
+    { "default",     16, 64,  2000, 64,  8 },
+    { "many_lights", 8,  32,  1000, 512, 4 },
+    { "dense_mesh",  2,  16, 50000, 16,  2 },
+    { "many_draws",  64, 64,   200, 32,  16 }
+};
+
+#define REGRESS_FRAMES 120
+#define REGRESS_WARMUP 30
+
+struct TimingSummary {
+    f64 mean;
+    f64 min;
+    f64 max;
+    f64 p50;
+    f64 p95;
+    f64 p99;
+};
+
+struct BenchResult {
+    TimingSummary cpu;
+    TimingSummary gpu;
+    u64 draw_calls;
+    u64 triangles;
+    u64 memory_bytes;
+    // Pipeline statistics of the last resolved frame, empty without device support
+    array<GPUPassStats> passes;
+    // Of the full resolution final frame, only equal on the same device and driver
+    u64 image_hash;
+    // RGB, BENCH_THUMBNAIL_SCALE times smaller than the frame
+    array<u8> thumbnail;
+};
+
+// xorshift32, the scene has to be the same on every platform
+static f32 Random(u32 *state) {
+    u32 x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+
+    return f32(x & 0xffffff) / f32(0x1000000);
+}
+
+static bool ParseArguments(int argc, char **argv, BenchConfig *config) {
+    struct { const char *name; u32 *value; } options[] = {
+        { "--meshes", &config->meshes },
+        { "--instances", &config->instances },
+        { "--triangles", &config->triangles },
+        { "--lights", &config->lights },
+        { "--materials", &config->materials },
+        { "--frames", &config->frames },
+        { "--warmup", &config->warmup },
+        { "--seed", &config->seed }
+    };
+
+    for (int i = 1; i < argc; ++i) {
+        bool found = false;
+
+        if (strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            config->output = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--regress") == 0 && i + 1 < argc) {
+            config->baseline_dir = argv[++i];
+            continue;
+        }
+        if (strcmp(argv[i], "--tolerance") == 0 && i + 1 < argc) {
+            config->tolerance = atof(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "--min-psnr") == 0 && i + 1 < argc) {
+            config->min_psnr = atof(argv[++i]);
+            continue;
+        }
+        if (strcmp(argv[i], "--update-baselines") == 0) {
+            config->update_baselines = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--allow-missing-baseline") == 0) {
+            config->allow_missing_baseline = true;
+            continue;
+        }
+        if (strcmp(argv[i], "--software") == 0) {
+            config->software = true;
+            continue;
+        }
+
+        for (u32 j = 0; j < ARRAY_SIZE(options); ++j) {
+            if (strcmp(argv[i], options[j].name) == 0 && i + 1 < argc) {
+                *options[j].value = u32(atoi(argv[++i]));
+                found = true;
+                break;
+            }
+        }
+
+        if (!found) {
+            LogError("Unknown argument %s", argv[i]);
+            LogInfo("Usage: RendererBench [--meshes n] [--instances n] [--triangles n] [--lights n] [--materials n] [--frames n] [--warmup n] [--seed n] [--output path] [--software]");
+            LogInfo("       RendererBench --regress dir [--update-baselines] [--allow-missing-baseline] [--tolerance percent] [--min-psnr db] [--software]");
+            return false;
+        }
+    }
+
+    if (config->update_baselines && !config->baseline_dir) {
+        LogError("--update-baselines needs --regress dir");
+        return false;
+    }
+
+    if (config->allow_missing_baseline && !config->baseline_dir) {
+        LogError("--allow-missing-baseline needs --regress dir");
+        return false;
+    }
+
+    if (config->meshes == 0 || config->instances == 0 || config->materials == 0 || config->frames == 0) {
+        LogError("Meshes, instances, materials and frames have to be at least 1");
+        return false;
+    }
+
+    return true;
+}
+
+// UV sphere with about the requested number of triangles, squashed a little per mesh
+static void GenerateMesh(CookedMesh *mesh, u32 triangles, glm::vec3 scale) {
+    u32 rings = u32(sqrtf(f32(triangles) / 4.0f));
+    rings = rings < 2 ? 2 : rings;
+    u32 segments = rings * 2;
+
+    for (u32 ring = 0; ring <= rings; ++ring) {
+        f32 theta = glm::pi<f32>() * f32(ring) / f32(rings);
+
+        for (u32 segment = 0; segment <= segments; ++segment) {
+            f32 phi = 2.0f * glm::pi<f32>() * f32(segment) / f32(segments);
+
+            glm::vec3 normal = glm::vec3(sinf(theta) * cosf(phi), cosf(theta), sinf(theta) * sinf(phi));
+            glm::vec3 position = normal * scale;
+
+            VertexAttributes attributes;
+            attributes.normal = glm::vec<4, u8>(
+                normal.x * 127.0f + 127.0f,
+                normal.y * 127.0f + 127.0f,
+                normal.z * 127.0f + 127.0f,
+                0
+            );
+            attributes.tex_coord = glm::vec<2, f32>(f32(segment) / f32(segments), f32(ring) / f32(rings));
+
+            mesh->positions.push_back({ position.x, position.y, position.z });
+            mesh->attributes.push_back(attributes);
+        }
+    }
+
+    for (u32 ring = 0; ring < rings; ++ring) {
+        for (u32 segment = 0; segment < segments; ++segment) {
+            u32 a = ring * (segments + 1) + segment;
+            u32 b = a + segments + 1;
+
+            mesh->indices.insert(mesh->indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+        }
+    }
+}
+
+static array<Model *> GenerateModels(BenchConfig *config, VkCommandPool command_pool, u32 *random) {
+    array<Material> materials(config->materials);
+    for (Material &material : materials) {
+        glm::vec4 color = glm::vec4(Random(random), Random(random), Random(random), 1.0f);
+
+        material = {};
+        material.ambient = color;
+        material.diffuse = color;
+        material.specular = glm::vec4(0.5f);
+        material.shininess = 32.0f;
+    }
+
+    array<Model *> models(config->meshes);
+
+    for (u32 i = 0; i < config->meshes; ++i) {
+        CookedModel data;
+        data.materials = materials;
+        data.meshes.resize(1);
+        data.meshes[0].material_index = i % config->materials;
+
+        glm::vec3 scale = glm::vec3(0.6f + Random(random) * 0.6f, 0.6f + Random(random) * 0.6f, 0.6f + Random(random) * 0.6f);
+        GenerateMesh(&data.meshes[0], config->triangles, scale);
+
+        models[i] = ModelImporter::Create(&data, command_pool);
+    }
+
+    return models;
+}
+
+static TimingSummary Summarize(array<f64> samples) {
+    TimingSummary summary = {};
+    if (samples.empty()) {
+        return summary;
+    }
+
+    std::sort(samples.begin(), samples.end());
+
+    f64 total = 0.0;
+    for (f64 sample : samples) {
+        total += sample;
+    }
+
+    u64 last = samples.size() - 1;
+    summary.mean = total / f64(samples.size());
+    summary.min = samples[0];
+    summary.max = samples[last];
+    summary.p50 = samples[u64(f64(last) * 0.50)];
+    summary.p95 = samples[u64(f64(last) * 0.95)];
+    summary.p99 = samples[u64(f64(last) * 0.99)];
+
+    return summary;
+}
+
+static void WriteSummary(FILE *file, const char *name, TimingSummary *summary, bool last) {
+    fprintf(
+        file, "    \"%s\": { \"mean\": %.4f, \"min\": %.4f, \"max\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f }%s\n",
+        name, summary->mean, summary->min, summary->max, summary->p50, summary->p95, summary->p99, last ? "" : ","
+    );
+}
+
+static bool WriteResults(BenchConfig *config, BenchResult *result) {
+    FILE *file = fopen(config->output, "w");
+    if (!file) {
+        LogError("Failed to open %s for the results", config->output);
+        return false;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "    \"device\": \"%s\",\n", VulkanPhysicalDevice::properties.deviceName);
+    fprintf(file, "    \"width\": %u,\n", BENCH_WIDTH);
+    fprintf(file, "    \"height\": %u,\n", BENCH_HEIGHT);
+    fprintf(file, "    \"meshes\": %u,\n", config->meshes);
+    fprintf(file, "    \"instances\": %u,\n", config->instances);
+    fprintf(file, "    \"triangles_per_mesh\": %u,\n", config->triangles);
+    fprintf(file, "    \"lights\": %u,\n", config->lights);
+    fprintf(file, "    \"materials\": %u,\n", config->materials);
+    fprintf(file, "    \"frames\": %u,\n", config->frames);
+    fprintf(file, "    \"draw_calls\": %lu,\n", result->draw_calls);
+    fprintf(file, "    \"triangles\": %lu,\n", result->triangles);
+    fprintf(file, "    \"memory_bytes\": %lu,\n", result->memory_bytes);
+
+    fprintf(file, "    \"passes\": [\n");
+    for (u64 i = 0; i < result->passes.size(); ++i) {
+        GPUPassStats *pass = &result->passes[i];
+        GPUPassCounters *counters = &pass->counters;
+
+        fprintf(
+            file,
+            "        { \"name\": \"%s\", \"submitted_triangles\": %lu, \"input_vertices\": %lu, \"input_primitives\": %lu, "
+            "\"vertex_invocations\": %lu, \"clipping_primitives\": %lu, \"fragment_invocations\": %lu }%s\n",
+            pass->name, pass->submitted_triangles, counters->input_vertices, counters->input_primitives,
+            counters->vertex_invocations, counters->clipping_primitives, counters->fragment_invocations,
+            i + 1 < result->passes.size() ? "," : ""
+        );
+    }
+    fprintf(file, "    ],\n");
+
+    WriteSummary(file, "cpu_ms", &result->cpu, false);
+    WriteSummary(file, "gpu_ms", &result->gpu, true);
+    fprintf(file, "}\n");
+
+    fclose(file);
+    return true;
+}
+
+// Box filters the BGRA frame into an RGB thumbnail
+static void CreateThumbnail(array<u8> &pixels, u32 width, u32 height, array<u8> *thumbnail) {
+    u32 thumbnail_width = width / BENCH_THUMBNAIL_SCALE;
+    u32 thumbnail_height = height / BENCH_THUMBNAIL_SCALE;
+    thumbnail->resize(thumbnail_width * thumbnail_height * 3);
+
+    for (u32 y = 0; y < thumbnail_height; ++y) {
+        for (u32 x = 0; x < thumbnail_width; ++x) {
+            u32 sum[3] = {};
+
+            for (u32 sy = 0; sy < BENCH_THUMBNAIL_SCALE; ++sy) {
+                for (u32 sx = 0; sx < BENCH_THUMBNAIL_SCALE; ++sx) {
+                    u8 *pixel = &pixels[((y * BENCH_THUMBNAIL_SCALE + sy) * width + x * BENCH_THUMBNAIL_SCALE + sx) * 4];
+                    sum[0] += pixel[2];
+                    sum[1] += pixel[1];
+                    sum[2] += pixel[0];
+                }
+            }
+
+            for (u32 c = 0; c < 3; ++c) {
+                (*thumbnail)[(y * thumbnail_width + x) * 3 + c] = u8(sum[c] / (BENCH_THUMBNAIL_SCALE * BENCH_THUMBNAIL_SCALE));
+            }
+        }
+    }
+}
+
+static void RunBench(BenchConfig *config, VulkanSwapchain *swapchain, RenderPass *render_pass, BenchResult *result) {
+    MasterRenderer *master_renderer = new MasterRenderer(render_pass);
+    SceneRenderer *scene_renderer = new SceneRenderer(swapchain, render_pass);
+
+    // The render scale would follow the GPU time and change the image from run to run
+    master_renderer->dynamic_resolution.enabled = false;
+
+    u32 random = config->seed ? config->seed : 1;
+    array<Model *> models = GenerateModels(config, render_pass->graphics_command_pool.handle, &random);
+
+    // Instances of all meshes share one square grid, interleaved so every mesh is spread over it
+    u32 instance_count = config->meshes * config->instances;
+    u32 grid_size = u32(ceilf(sqrtf(f32(instance_count))));
+    f32 grid_extent = f32(grid_size) * BENCH_SPACING;
+
+    array<glm::mat4> transformations(instance_count);
+    for (u32 i = 0; i < instance_count; ++i) {
+        glm::vec3 position = glm::vec3(f32(i % grid_size) * BENCH_SPACING, 1.0f, f32(i / grid_size) * BENCH_SPACING);
+        transformations[i] = glm::translate(glm::mat4(1.0f), position) * glm::rotate(glm::mat4(1.0f), Random(&random) * 6.28f, glm::vec3(0.0f, 1.0f, 0.0f));
+    }
+
+    array<PointLight> lights(config->lights);
+    for (PointLight &light : lights) {
+        glm::vec4 color = glm::vec4(Random(&random), Random(&random), Random(&random), 1.0f);
+
+        light.pos = glm::vec3(Random(&random) * grid_extent, 0.5f + Random(&random) * 3.0f, Random(&random) * grid_extent);
+        light.ambient = color * 0.05f;
+        light.diffuse = color;
+        light.radius = BENCH_SPACING * 3.0f;
+    }
+
+    if (!lights.empty()) {
+        scene_renderer->SetLights(lights.data(), u32(lights.size()));
+    }
+
+    glm::vec3 center = glm::vec3(grid_extent * 0.5f, 0.0f, grid_extent * 0.5f);
+    f32 orbit_radius = grid_extent * 0.6f + 10.0f;
+
+    SceneData scene_data = {};
+    scene_data.dir_light.dir = glm::vec3(0.3f, 1.0f, 0.3f);
+    scene_data.dir_light.ambient = glm::vec4(0.2f);
+    scene_data.dir_light.diffuse = glm::vec4(1.0f);
+    scene_data.projection = glm::perspective(glm::radians(45.0f), f32(BENCH_WIDTH) / f32(BENCH_HEIGHT), 0.1f, orbit_radius * 3.0f);
+    scene_data.projection[1][1] *= -1;
+
+    array<f64> cpu_times;
+    array<f64> gpu_times;
+
+    LogInfo("Rendering %u frames of %u instances with %u triangles each and %u lights", config->frames, instance_count, config->triangles, config->lights);
+
+    u32 total_frames = config->warmup + config->frames;
+
+    for (u32 frame = 0; frame < total_frames; ++frame) {
+        f64 frame_begin = GetTime();
+
+        // One full orbit over the whole run, the same path for every run
+        f32 angle = 2.0f * glm::pi<f32>() * f32(frame) / f32(total_frames);
+        glm::vec3 eye = center + glm::vec3(cosf(angle) * orbit_radius, orbit_radius * 0.5f, sinf(angle) * orbit_radius);
+
+        scene_data.view = glm::lookAtRH(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+        scene_renderer->SetSceneData(&scene_data);
+
+        VkCommandBuffer cmd_buf = master_renderer->Begin();
+        scene_renderer->Begin(cmd_buf);
+
+        for (u32 i = 0; i < instance_count; ++i) {
+            Model *model = models[i % config->meshes];
+            model->transformation = transformations[i];
+            scene_renderer->RenderModel(model);
+        }
+
+        scene_renderer->Prepare();
+        master_renderer->BeginPass();
+        scene_renderer->End();
+        master_renderer->End();
+
+        if (frame >= config->warmup) {
+            cpu_times.push_back((GetTime() - frame_begin) * 1000.0);
+            // Timestamps are read back a few frames late, without stalling
+            if (RenderStats::gpu_frame_time > 0.0) {
+                gpu_times.push_back(RenderStats::gpu_frame_time);
+            }
+
+            result->draw_calls = RenderStats::draw_calls;
+            result->triangles = RenderStats::triangles;
+        }
+    }
+
+    VK_CHECK(vkDeviceWaitIdle(VulkanDevice::handle));
+
+    result->cpu = Summarize(cpu_times);
+    result->gpu = Summarize(gpu_times);
+    result->memory_bytes = GetVulkanMemoryUsage();
+    // Cleared with the master renderer
+    result->passes = GPUPipelineStats::passes;
+
+    LogInfo("cpu: mean %.3fms, p95 %.3fms, p99 %.3fms", result->cpu.mean, result->cpu.p95, result->cpu.p99);
+    LogInfo("gpu: mean %.3fms, p95 %.3fms, p99 %.3fms", result->gpu.mean, result->gpu.p95, result->gpu.p99);
+
+    // Headless frames end up in TRANSFER_SRC_OPTIMAL, the last one is still in current_image
+    Image *final_image = &swapchain->offscreen_images[render_pass->current_image];
+
+    array<u8> pixels;
+    ReadImagePixels(final_image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, render_pass->graphics_command_pool.handle, &pixels);
+
+    result->image_hash = HashBytes(pixels.data(), pixels.size());
+    CreateThumbnail(pixels, final_image->width, final_image->height, &result->thumbnail);
+
+    for (Model *model : models) {
+        delete model;
+    }
+
+    delete scene_renderer;
+    delete master_renderer;
+
+    // The device is idle, so the next scene starts without this one's buffers
+    DeletionQueue::Flush();
+}
+
+static bool WritePPM(const char *path, array<u8> &rgb, u32 width, u32 height) {
+    FILE *file = fopen(path, "wb");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "P6\n%u %u\n255\n", width, height);
+    fwrite(rgb.data(), 1, rgb.size(), file);
+    fclose(file);
+
+    return true;
+}
+
+// Only reads what WritePPM writes
+static bool ReadPPM(const char *path, array<u8> *rgb, u32 width, u32 height) {
+    FILE *file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+
+    u32 file_width = 0;
+    u32 file_height = 0;
+    u32 max_value = 0;
+    bool valid = fscanf(file, "P6 %u %u %u", &file_width, &file_height, &max_value) == 3 &&
+        file_width == width && file_height == height && max_value == 255 && fgetc(file) == '\n';
+
+    if (valid) {
+        rgb->resize(width * height * 3);
+        valid = fread(rgb->data(), 1, rgb->size(), file) == rgb->size();
+    }
+
+    fclose(file);
+    return valid;
+}
+
+static f64 CalculatePSNR(array<u8> &a, array<u8> &b) {
+    f64 error = 0.0;
+    for (u64 i = 0; i < a.size(); ++i) {
+        f64 difference = f64(a[i]) - f64(b[i]);
+        error += difference * difference;
+    }
+
+    if (error == 0.0) {
+        return INFINITY;
+    }
+
+    f64 mse = error / f64(a.size());
+    return 10.0 * log10(255.0 * 255.0 / mse);
+}
+
+// Value of "key" in a flat JSON object as written by WriteBaseline, 0 if it's missing
+static const char *FindJsonValue(const char *json, const char *key) {
+    string pattern = "\"" + string(key) + "\":";
+
+    const char *value = strstr(json, pattern.c_str());
+    if (!value) {
+        return 0;
+    }
+
+    value += pattern.size();
+    while (*value == ' ') {
+        value++;
+    }
+
+    return value;
+}
+
+static bool WriteBaseline(const char *json_path, const char *device, BenchResult *result) {
+    FILE *file = fopen(json_path, "w");
+    if (!file) {
+        return false;
+    }
+
+    fprintf(file, "{\n");
+    fprintf(file, "    \"device\": \"%s\",\n", device);
+    fprintf(file, "    \"cpu_p50\": %.4f,\n", result->cpu.p50);
+    fprintf(file, "    \"gpu_p50\": %.4f,\n", result->gpu.p50);
+    fprintf(file, "    \"draw_calls\": %lu,\n", result->draw_calls);
+    fprintf(file, "    \"triangles\": %lu,\n", result->triangles);
+    fprintf(file, "    \"memory_bytes\": %lu,\n", result->memory_bytes);
+    fprintf(file, "    \"image_hash\": \"%016lx\"\n", result->image_hash);
+    fprintf(file, "}\n");
+
+    fclose(file);
+    return true;
+}
+
+// Larger than the baseline by more than the tolerance
+static bool CheckLimit(const char *scene, const char *name, f64 value, f64 baseline, f64 tolerance) {
+    f64 limit = baseline * (1.0 + tolerance / 100.0);
+    if (value <= limit) {
+        return true;
+    }
+
+    LogError("%s: %s regressed from %.3f to %.3f (limit %.3f)", scene, name, baseline, value, limit);
+    return false;
+}
+
+enum class BaselineResult {
+    Passed,
+    Failed,
+    // Nothing recorded for the scene, a failure unless --allow-missing-baseline is given
+    Missing
+};
+
+static BaselineResult CompareBaseline(BenchConfig *config, const char *scene, const char *device, BenchResult *result) {
+    string base_path = string(config->baseline_dir) + "/" + scene;
+    string json_path = base_path + ".json";
+    string image_path = base_path + ".ppm";
+
+    u32 thumbnail_width = BENCH_WIDTH / BENCH_THUMBNAIL_SCALE;
+    u32 thumbnail_height = BENCH_HEIGHT / BENCH_THUMBNAIL_SCALE;
+
+    if (config->update_baselines) {
+        bool written = WriteBaseline(json_path.c_str(), device, result) &&
+            WritePPM(image_path.c_str(), result->thumbnail, thumbnail_width, thumbnail_height);
+
+        if (!written) {
+            LogError("%s: failed to write the baseline to %s", scene, json_path.c_str());
+            return BaselineResult::Failed;
+        }
+
+        LogInfo("%s: wrote baseline %s", scene, json_path.c_str());
+        return BaselineResult::Passed;
+    }
+
+    char *json = ReadEntireFile(json_path.c_str());
+    if (!json) {
+        LogError("%s: no baseline at %s. Record it with --update-baselines", scene, json_path.c_str());
+        return BaselineResult::Missing;
+    }
+
+    const char *values[7] = {
+        FindJsonValue(json, "device"),
+        FindJsonValue(json, "cpu_p50"),
+        FindJsonValue(json, "gpu_p50"),
+        FindJsonValue(json, "draw_calls"),
+        FindJsonValue(json, "triangles"),
+        FindJsonValue(json, "memory_bytes"),
+        FindJsonValue(json, "image_hash")
+    };
+
+    for (u32 i = 0; i < ARRAY_SIZE(values); ++i) {
+        if (!values[i]) {
+            LogError("%s: baseline %s is incomplete", scene, json_path.c_str());
+            delete[] json;
+            return BaselineResult::Failed;
+        }
+    }
+
+    // Both strings are quoted
+    string baseline_device = string(values[0] + 1, strchr(values[0] + 1, '"'));
+    u64 baseline_hash = strtoull(values[6] + 1, 0, 16);
+
+    bool passed = true;
+
+    // Timings of other devices say nothing, the counts and the image still have to match
+    if (baseline_device == device) {
+        passed = CheckLimit(scene, "median cpu ms", result->cpu.p50, strtod(values[1], 0), config->tolerance) && passed;
+        passed = CheckLimit(scene, "median gpu ms", result->gpu.p50, strtod(values[2], 0), config->tolerance) && passed;
+    } else {
+        LogInfo("%s: baseline is from %s, not comparing timings", scene, baseline_device.c_str());
+    }
+
+    // The scenes are generated from a fixed seed, so the counts are exact
+    passed = CheckLimit(scene, "draw calls", f64(result->draw_calls), strtod(values[3], 0), 0.0) && passed;
+    passed = CheckLimit(scene, "triangles", f64(result->triangles), strtod(values[4], 0), 0.0) && passed;
+    passed = CheckLimit(scene, "memory bytes", f64(result->memory_bytes), strtod(values[5], 0), config->tolerance) && passed;
+
+    delete[] json;
+
+    if (result->image_hash != baseline_hash) {
+        array<u8> baseline_thumbnail;
+        if (!ReadPPM(image_path.c_str(), &baseline_thumbnail, thumbnail_width, thumbnail_height)) {
+            LogError("%s: failed to read the baseline image %s", scene, image_path.c_str());
+            return BaselineResult::Failed;
+        }
+
+        f64 psnr = CalculatePSNR(result->thumbnail, baseline_thumbnail);
+        if (psnr < config->min_psnr) {
+            LogError("%s: final frame changed, psnr %.2fdB is below %.2fdB", scene, psnr, config->min_psnr);
+            passed = false;
+        } else {
+            LogInfo("%s: final frame differs slightly, psnr %.2fdB", scene, psnr);
+        }
+    }
+
+    LogInfo("%s: %s", scene, passed ? "passed" : "FAILED");
+    return passed ? BaselineResult::Passed : BaselineResult::Failed;
+}
+
+static bool RunRegression(BenchConfig *config, VulkanSwapchain *swapchain, RenderPass *render_pass) {
+    u32 failed = 0;
+    u32 skipped = 0;
+
+    if (config->update_baselines) {
+        std::error_code error;
+        std::filesystem::create_directories(config->baseline_dir, error);
+    }
+
+    for (ReferenceScene &scene : reference_scenes) {
+        BenchConfig scene_config = *config;
+        scene_config.meshes = scene.meshes;
+        scene_config.instances = scene.instances;
+        scene_config.triangles = scene.triangles;
+        scene_config.lights = scene.lights;
+        scene_config.materials = scene.materials;
+        scene_config.frames = REGRESS_FRAMES;
+        scene_config.warmup = REGRESS_WARMUP;
+        scene_config.seed = 1;
+
+        LogInfo("Scene %s", scene.name);
+
+        BenchResult result = {};
+        RunBench(&scene_config, swapchain, render_pass, &result);
+
+        BaselineResult compared = CompareBaseline(config, scene.name, VulkanPhysicalDevice::properties.deviceName, &result);
+        if (compared == BaselineResult::Failed) {
+            failed++;
+        } else if (compared == BaselineResult::Missing) {
+            if (config->allow_missing_baseline) {
+                skipped++;
+            } else {
+                failed++;
+            }
+        }
+    }
+
+    u32 scene_count = u32(ARRAY_SIZE(reference_scenes));
+
+    if (skipped > 0) {
+        LogInfo("%u of %u scenes have no baseline in %s and were skipped, --allow-missing-baseline is set", skipped, scene_count, config->baseline_dir);
+    }
+
+    if (failed > 0) {
+        LogError("%u of %u scenes failed", failed, scene_count);
+        return false;
+    }
+
+    LogInfo("%u of %u scenes passed", scene_count - skipped, scene_count);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    BenchConfig config;
+    if (!ParseArguments(argc, argv, &config)) {
+        return 1;
+    }
+
+    VulkanContext context = VulkanContext::Get(false, true);
+    context.prefer_software = config.software;
+
+    VulkanInstance::Create(&context, 0, "RendererBench");
+
+    VulkanPhysicalDevice::Pick(&context);
+    VulkanDevice::Create(&context);
+
+    CreateVulkanAllocator();
+    VulkanPipelineCache::Create("Renderer/Assets/.pipeline_cache");
+    PipelineCompiler::Create();
+
+    VulkanSwapchain swapchain;
+    swapchain.CreateHeadless({ BENCH_WIDTH, BENCH_HEIGHT }, BENCH_IMAGES);
+
+    RenderPass render_pass;
+    render_pass.Create(&swapchain);
+
+    bool passed;
+
+    if (config.baseline_dir) {
+        passed = RunRegression(&config, &swapchain, &render_pass);
+    } else {
+        BenchResult result = {};
+        RunBench(&config, &swapchain, &render_pass, &result);
+
+        passed = WriteResults(&config, &result);
+        if (passed) {
+            LogInfo("Wrote results to %s", config.output);
+        }
+    }
+
+    render_pass.Destroy();
+    swapchain.Destroy();
+
+    PipelineCompiler::Destroy();
+    VulkanPipelineCache::Destroy();
+    DeletionQueue::Flush();
+    DestroyVulkanAllocator();
+
+    VulkanDevice::Destroy();
+    VulkanInstance::Destroy();
+
+    return passed ? 0 : 1;
+}
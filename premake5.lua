@@ -70,9 +70,13 @@ project "VulkanRenderer"
             "%{VULKAN_SDK}/lib"
         }
 
+        dependson {
+            "AssetCooker"
+        }
+
         filter "system:Windows"
             postbuildcommands {
-                "call ./scripts/compile_shaders.cmd"
+                "\"bin/" .. outputdir .. "/AssetCooker.exe\" Renderer/Assets"
             }
 
             links {
@@ -97,7 +101,7 @@ project "VulkanRenderer"
 
         filter "system:Linux"
             postbuildcommands {
-                shell_path .. " ./scripts/compile_shaders.sh"
+                "./bin/" .. outputdir .. "/AssetCooker Renderer/Assets"
             }
 
             linkoptions {
@@ -118,9 +122,125 @@ project "VulkanRenderer"
 
         filter "system:Mac"
             postbuildcommands {
-                shell_path .. " ./scripts/compile_shaders.sh"
+                "./bin/" .. outputdir .. "/AssetCooker Renderer/Assets"
+            }
+
+            libdirs {
+                glfw3_path .. "/lib",
+                assimp_path .. "/lib"
+            }
+
+            includedirs {
+                glfw3_path .. "/include",
+                assimp_path .. "/include"
+            }
+
+            links {
+                "glfw",
+                "vulkan",
+                "assimp"
+            }
+
+        filter "configurations:Debug"
+            defines "VULKAN_RENDERER_DEBUG"
+            runtime "Debug"
+            symbols "on"
+
+        filter "configurations:Release"
+            defines "VULKAN_RENDERER_RELEASE"
+            runtime "Release"
+            optimize "on"
+            
+        filter "configurations:Dist"
+            defines "VULKAN_RENDERER_DIST"
+            runtime "Release"
+            optimize "on"
+
+
+project "RendererBench"
+    kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++20"
+        staticruntime "off"
+
+        targetdir ("bin/" .. outputdir)
+        objdir ("bin/" .. outputdir .. "/temp/RendererBench")
+
+        files
+        {
+            "RendererBench/**.cpp",
+            "Renderer/**.h",
+            "Renderer/**.cpp"
+        }
+
+        -- The bench has its own main
+        removefiles
+        {
+            "Renderer/Main.cpp"
+        }
+
+        includedirs
+        {
+            "Renderer",
+            "vendor/glm",
+            "vendor/sh_libs",
+            "%{VULKAN_SDK}/include",
+        }
+
+        defines
+        {
+            "GLFW_INCLUDE_NONE"
+        }
+
+        libdirs {
+            "%{VULKAN_SDK}/lib"
+        }
+
+        -- Shaders are cooked by the renderer's post build step
+        dependson {
+            "AssetCooker",
+            "VulkanRenderer"
+        }
+
+        filter "system:Windows"
+            links {
+                "assimp.lib",
+                "glfw3.lib",
+                "freetype.lib",
+                "vulkan-1.lib"
+            }
+
+            libdirs {
+                "vendor/assimp/libs",
+                "vendor/glfw/libs",
+                "vendor/freetype2/libs"
+            }
+
+            includedirs {
+                "vendor/assimp/include",
+                "vendor/glfw/include",
+                "vendor/freetype2/include",
+                "vendor/freetype2/include/freetype2"
+            }
+
+        filter "system:Linux"
+            linkoptions {
+                "`pkg-config --static --libs glfw3`",
+                "`pkg-config --static --libs assimp`",
+                "`pkg-config --static --libs freetype2`"
+            }
+
+            buildoptions {
+                "`pkg-config --cflags glfw3`",
+                "`pkg-config --cflags assimp`",
+                "`pkg-config --cflags freetype2`"
             }
 
+            links {
+                "vulkan"
+            }
+
+        filter "system:Mac"
             libdirs {
                 glfw3_path .. "/lib",
                 assimp_path .. "/lib"
@@ -151,3 +271,81 @@ project "VulkanRenderer"
             defines "VULKAN_RENDERER_DIST"
             runtime "Release"
             optimize "on"
+
+
+project "AssetCooker"
+    kind "ConsoleApp"
+        language "C++"
+        cppdialect "C++20"
+        staticruntime "off"
+
+        targetdir ("bin/" .. outputdir)
+        objdir ("bin/" .. outputdir .. "/temp/AssetCooker")
+
+        files
+        {
+            "AssetCooker/**.h",
+            "AssetCooker/**.cpp",
+            "Renderer/Common.cpp",
+            "Renderer/Core/KTX2.cpp",
+            "Renderer/Graphics/ModelData.cpp"
+        }
+
+        includedirs
+        {
+            "Renderer",
+            "vendor/glm",
+            "vendor/sh_libs",
+            "%{VULKAN_SDK}/include",
+        }
+
+        filter "system:Windows"
+            links {
+                "assimp.lib"
+            }
+
+            libdirs {
+                "vendor/assimp/libs"
+            }
+
+            includedirs {
+                "vendor/assimp/include"
+            }
+
+        filter "system:Linux"
+            linkoptions {
+                "`pkg-config --static --libs assimp`"
+            }
+
+            buildoptions {
+                "`pkg-config --cflags assimp`"
+            }
+
+            links {
+                "pthread"
+            }
+
+        filter "system:Mac"
+            libdirs {
+                assimp_path .. "/lib"
+            }
+
+            includedirs {
+                assimp_path .. "/include"
+            }
+
+            links {
+                "assimp"
+            }
+
+        filter "configurations:Debug"
+            runtime "Debug"
+            symbols "on"
+
+        filter "configurations:Release"
+            runtime "Release"
+            optimize "on"
+
+        filter "configurations:Dist"
+            runtime "Release"
+            optimize "on"